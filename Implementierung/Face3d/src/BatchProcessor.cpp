@@ -0,0 +1,294 @@
+#include "BatchProcessor.hpp"
+#include "BlockingQueue.hpp"
+#include "DetectionWorkspace.hpp"
+#include "FileUtils.hpp"
+#include "GeometryStore.hpp"
+#include "StageTimer.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+
+
+namespace Face3D
+{
+	namespace
+	{
+		/** a pair on its way through the pipeline */
+		struct BatchJob
+		{
+			size_t index;
+			int64 start; ///< ticks when decoding started, for the latency
+			cv::Mat front, side;
+			Detection::DetectFaceResult result;
+			GeometryStoreRow row; ///< pair id and time of each stage, gets the geometry at the end
+			std::string error; ///< empty if everything went fine so far
+		};
+
+		typedef std::shared_ptr<BatchJob> BatchJobPtr;
+
+		bool fileExists(const std::string& fn)
+		{
+			return std::ifstream(fn.c_str()).good();
+		}
+
+		/** ms since the given ticks */
+		float msSince(int64 ticks)
+		{
+			return static_cast<float>((cv::getTickCount() - ticks) * 1000.0 / cv::getTickFrequency());
+		}
+
+		/** value at the given fraction of the sorted values */
+		double percentile(const std::vector<double>& sorted, double p)
+		{
+			if (sorted.empty())
+			{
+				return 0.0;
+			}
+			const size_t idx = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+			return sorted[idx];
+		}
+
+		/** start n threads which all run the function */
+		void startThreads(std::vector<std::thread>& threads, int n, const std::function<void()>& fn)
+		{
+			for (int i = 0; i < std::max(n, 1); ++i)
+			{
+				threads.push_back(std::thread(fn));
+			}
+		}
+
+		void joinThreads(std::vector<std::thread>& threads)
+		{
+			for (size_t i = 0; i < threads.size(); ++i)
+			{
+				threads[i].join();
+			}
+			threads.clear();
+		}
+	}
+
+
+
+	bool findImagePairs(const std::string& input, std::vector<ImagePair>& pairs)
+	{
+		pairs.clear();
+
+		// manifest
+		if (input.size() > 4 && input.substr(input.size() - 4) == ".txt")
+		{
+			std::ifstream f(input.c_str());
+			if (!f)
+			{
+				return false;
+			}
+			std::string line;
+			while (std::getline(f, line))
+			{
+				std::stringstream ss(line);
+				ImagePair pair;
+				if (line.empty() || line[0] == '#' || !(ss >> pair.front >> pair.side))
+				{
+					continue;
+				}
+				if (!(ss >> pair.name))
+				{
+					std::stringstream name;
+					name << "pair" << pairs.size();
+					pair.name = name.str();
+				}
+				pairs.push_back(pair);
+			}
+			return true;
+		}
+
+		// directory: <name>Front.<ext> and <name>Side.<ext>, e.g. haraldFront.jpg and haraldSide.jpg
+		std::vector<std::string> frontFiles;
+		cv::glob(input + "/*Front.*", frontFiles, false);
+		std::sort(frontFiles.begin(), frontFiles.end());
+		for (size_t i = 0; i < frontFiles.size(); ++i)
+		{
+			const std::string& front = frontFiles[i];
+			const size_t pos = front.rfind("Front.");
+			const size_t nameStart = front.find_last_of("/\\") + 1;
+			ImagePair pair;
+			pair.front = front;
+			pair.side = front.substr(0, pos) + "Side" + front.substr(pos + 5);
+			pair.name = front.substr(nameStart, pos - nameStart);
+			if (pair.name.empty())
+			{
+				std::stringstream name;
+				name << "pair" << pairs.size();
+				pair.name = name.str();
+			}
+			if (fileExists(pair.side))
+			{
+				pairs.push_back(pair);
+			}
+		}
+		return true;
+	}
+
+
+
+	int processBatch(const std::vector<ImagePair>& pairs, const BatchOptions& options)
+	{
+		if (!createDirectory(options.outDir))
+		{
+			const std::string msg = "couldn't create " + options.outDir;
+			throw std::exception(msg.c_str());
+		}
+		GeometryStore store(options.outDir + "/faceGeometry.col");
+
+		BlockingQueue<BatchJobPtr> decoded(options.queueSize);
+		BlockingQueue<BatchJobPtr> detected(options.queueSize);
+		std::atomic<size_t> nextPair(0);
+
+		std::mutex resultMutex;
+		std::vector<double> latencies;
+		int failed = 0;
+
+		// decode: read the files and decode them, the pairs are taken in order
+		const std::function<void()> decodeStage = [&]()
+		{
+			for (size_t i = nextPair++; i < pairs.size(); i = nextPair++)
+			{
+				BatchJobPtr job = std::make_shared<BatchJob>();
+				job->index = i;
+				job->start = cv::getTickCount();
+				job->row.pairId = pairIdFromName(pairs[i].name);
+
+				// an exception must not leave the thread, the pair is reported as failed instead
+				try
+				{
+					ScopedStageTimer timer("decode");
+					job->front = loadImage(pairs[i].front, options.decodeSize);
+					job->side = loadImage(pairs[i].side, options.decodeSize);
+					if (job->front.empty() || job->side.empty())
+					{
+						job->error = "couldn't read the images";
+					}
+				}
+				catch (std::exception e)
+				{
+					job->error = e.what();
+				}
+				job->row.stageMs[GeometryStoreRow::Decode] = msSince(job->start);
+				decoded.push(job);
+			}
+		};
+
+		// detect: each thread with its own workspace. the front and side image are not split into two threads, the workers already use the cores.
+		const std::function<void()> detectStage = [&]()
+		{
+			std::shared_ptr<DetectionWorkspace> workspace = std::make_shared<DetectionWorkspace>();
+			Detection::DetectFaceOptions detectOptions = options.detectOptions;
+			detectOptions.concurrent = false;
+
+			BatchJobPtr job;
+			while (decoded.pop(job))
+			{
+				const int64 detectStart = cv::getTickCount();
+				if (job->error.empty())
+				{
+					try
+					{
+						Detection detection(job->front, job->side, workspace);
+						job->result = detection.detectFaceHeadless(detectOptions);
+
+						// the textures share their memory with the workspace, which is overwritten by the next pair
+						job->result.textureFront = job->result.textureFront.clone();
+						job->result.textureSide = job->result.textureSide.clone();
+					}
+					catch (std::exception e)
+					{
+						job->error = e.what();
+					}
+				}
+				job->row.stageMs[GeometryStoreRow::Detect] = msSince(detectStart);
+				job->front.release();
+				job->side.release();
+				detected.push(job);
+			}
+		};
+
+		// encode: write the result files of each pair into its own directory
+		const std::function<void()> encodeStage = [&]()
+		{
+			BatchJobPtr job;
+			while (detected.pop(job))
+			{
+				const ImagePair& pair = pairs[job->index];
+				if (job->error.empty())
+				{
+					const int64 encodeStart = cv::getTickCount();
+					try
+					{
+						{
+							ScopedStageTimer timer("encode");
+							const std::string dir = options.outDir + "/" + pair.name;
+							if (!createDirectory(dir))
+							{
+								const std::string msg = "couldn't create " + dir;
+								throw std::exception(msg.c_str());
+							}
+							job->result.faceGeometry.toFile(dir + "/faceGeometry.bin");
+							if (!cv::imwrite(dir + "/front.jpg", job->result.textureFront) || !cv::imwrite(dir + "/side.jpg", job->result.textureSide))
+							{
+								job->error = "couldn't write the textures";
+							}
+						}
+
+						// one row per pair instead of one file
+						if (job->error.empty())
+						{
+							job->row.stageMs[GeometryStoreRow::Encode] = msSince(encodeStart);
+							job->row.geometry = job->result.faceGeometry.toRecord();
+							store.append(job->row);
+						}
+					}
+					catch (std::exception e)
+					{
+						job->error = e.what();
+					}
+				}
+				const double ms = (cv::getTickCount() - job->start) * 1000.0 / cv::getTickFrequency();
+
+				std::lock_guard<std::mutex> lock(resultMutex);
+				if (job->error.empty())
+				{
+					latencies.push_back(ms);
+				}
+				else
+				{
+					++failed;
+					std::cout << pair.name << ": " << job->error << "\n";
+				}
+			}
+		};
+
+		// the queue of a stage gets closed when all threads of the stage before are done
+		const int64 start = cv::getTickCount();
+		std::vector<std::thread> decoders, workers, encoders;
+		startThreads(decoders, options.decodeThreads, decodeStage);
+		startThreads(workers, options.workers, detectStage);
+		startThreads(encoders, options.encodeThreads, encodeStage);
+		joinThreads(decoders);
+		decoded.close();
+		joinThreads(workers);
+		detected.close();
+		joinThreads(encoders);
+		const double secs = (cv::getTickCount() - start) / cv::getTickFrequency();
+
+		std::sort(latencies.begin(), latencies.end());
+		std::cout << pairs.size() << " image pair(s), " << failed << " failed, " << secs << "s: " << latencies.size() / secs << " pairs/sec\n"
+			<< "latency [ms]: p50 " << percentile(latencies, 0.5) << ", p90 " << percentile(latencies, 0.9)
+			<< ", p99 " << percentile(latencies, 0.99) << ", max " << percentile(latencies, 1.0) << "\n";
+
+		return failed;
+	}
+}
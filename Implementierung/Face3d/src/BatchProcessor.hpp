@@ -0,0 +1,52 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include "Detection.hpp"
+#include "ImageLoader.hpp"
+
+/*
+Batch mode: process many image pairs in one process. The pairs flow through a pipeline of three stages
+(decode -> detect -> encode) connected by bounded queues, each stage runs in its own threads.
+Each detection thread has its own DetectionWorkspace, so after the first pairs nothing gets allocated by the detection.
+The geometries and the stage timings of all pairs are appended to one columnar file (GeometryStore.hpp) for the analysis.
+*/
+
+namespace Face3D
+{
+	/** a front and a side image which belong together */
+	struct ImagePair
+	{
+		std::string name; ///< name of the output directory
+		std::string front;
+		std::string side;
+	};
+
+	/** parameters of the batch mode */
+	struct BatchOptions
+	{
+		Detection::DetectFaceOptions detectOptions;
+		int workers = 4; ///< detection threads
+		int decodeThreads = 2; ///< threads which read and decode the images
+		int encodeThreads = 1; ///< threads which encode and write the results
+		size_t queueSize = 8; ///< max. number of pairs waiting between two stages, limits the memory
+		int decodeSize = defaultMinDecodeSize; ///< min. size of the decoded images, see decodeImage()
+		std::string outDir = "batch"; ///< each pair gets a subdirectory with the same files as ipc/, the geometries are also appended to outDir/faceGeometry.col
+	};
+
+	/** \brief  collect the image pairs of a directory or a manifest
+	* \param input a directory with files named <name>Front.<ext> and <name>Side.<ext>,
+	*        or a manifest (.txt): one pair per line "front side [name]", lines starting with # are ignored
+	* \param pairs the pairs found
+	* \return false if the manifest couldn't be read
+	*/
+	bool findImagePairs(const std::string& input, std::vector<ImagePair>& pairs);
+
+	/** \brief  process all pairs and report pairs/sec and the latency distribution
+	* \param pairs the image pairs
+	* \param options parameters of the detection and the pipeline
+	* \return number of pairs which failed
+	*/
+	int processBatch(const std::vector<ImagePair>& pairs, const BatchOptions& options);
+}
@@ -0,0 +1,290 @@
+#include "Benchmark.hpp"
+#include "SkinSegmentation.hpp"
+#include "SkinClassifier.hpp"
+#include "DetectionWorkspace.hpp"
+#include "FileUtils.hpp"
+#include "ImageLoader.hpp"
+#include "BinaryMask.hpp"
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+
+namespace Face3D
+{
+	/** run the function several times and return the average time of a single call in milliseconds */
+	double measureMs(const std::function<void()>& func, int iterations)
+	{
+		// warm-up, e.g. allocation of the output images
+		func();
+
+		const int64 start = cv::getTickCount();
+		for (int i = 0; i < iterations; ++i)
+		{
+			func();
+		}
+		return (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency() / iterations;
+	}
+
+
+	void benchmarkColorThresholdUpdate(const cv::Mat& preprocessed, const SkinThresholds& thresholds)
+	{
+		// what the gui does on every trackbar change: full segmentation vs. threshold of the cached chroma planes, both followed by the erosion
+		const cv::Mat structElement = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(5, 5), cv::Point(1, 1));
+		cv::Mat cr, cb, mask, eroded;
+		extractChroma(preprocessed, cr, cb);
+
+		const int iterations = 200;
+		const double fullMs = measureMs([&](){ segmentSkinReference(preprocessed, mask, thresholds); cv::erode(mask, eroded, structElement); }, iterations);
+		const double cachedMs = measureMs([&](){ thresholdChroma(cr, cb, mask, thresholds); cv::erode(mask, eroded, structElement); }, iterations);
+
+		std::cout << "color threshold trackbar update (" << preprocessed.cols << "x" << preprocessed.rows << ", one image): "
+			<< "full recompute " << fullMs << "ms, cached chroma planes " << cachedMs << "ms\n";
+	}
+
+
+	void benchmarkDecode(const std::string& fn)
+	{
+		std::vector<uchar> bytes;
+		cv::Size size;
+		if (!readFile(fn, bytes))
+		{
+			throw std::exception("benchmark: couldn't read the input image");
+		}
+		const bool isJpeg = readJpegSize(bytes, size);
+		if (!isJpeg)
+		{
+			std::cout << "decode: not a JPEG file, only the full decode is measured\n";
+		}
+
+		// what the pipeline needs: the detection image, the textures come from the decoded image
+		const int iterations = 5;
+		const int reductions[] = { 1, 2, 4, 8 };
+		const int chosen = isJpeg ? chooseDecodeReduction(size, defaultMinDecodeSize) : 1;
+		double fullMs = 0.0;
+		for (size_t i = 0; i < sizeof(reductions) / sizeof(reductions[0]); ++i)
+		{
+			if (reductions[i] > 1 && !isJpeg)
+			{
+				break;
+			}
+
+			cv::Mat decoded, resized;
+			const double decodeMs = measureMs([&](){ decoded = decodeImageReduced(bytes, reductions[i]); }, iterations);
+			const double resizeMs = measureMs([&](){ cv::resize(decoded, resized, cv::Size(320, 320), 0, 0, cv::INTER_AREA); }, iterations);
+			fullMs = i == 0 ? decodeMs + resizeMs : fullMs;
+
+			std::cout << "decode 1/" << reductions[i] << " (" << decoded.cols << "x" << decoded.rows << "): " << decodeMs << "ms, resize to 320x320 " << resizeMs << "ms"
+				<< ", speedup " << fullMs / (decodeMs + resizeMs) << (reductions[i] == chosen ? " <- used for this image\n" : "\n");
+		}
+	}
+
+
+	void benchmarkPreprocessing(const cv::Mat& img)
+	{
+		if (img.empty())
+		{
+			throw std::exception("benchmark: input image is empty");
+		}
+
+		const int sizes[] = { 320, 640, 1280 };
+		const SkinThresholds thresholds = getSkinThresholds(0, 0);
+		SkinClassifier::Instance().prepare(thresholds);
+
+		std::cout << "preprocessing + skin segmentation: blur BGR + lookup table vs. blur chroma planes vs. blur chroma planes at half resolution\n";
+		std::cout << std::setw(8) << "imgSize" << std::setw(12) << "bgr [ms]" << std::setw(14) << "chroma [ms]" << std::setw(10) << "speedup"
+			<< std::setw(12) << "half [ms]" << std::setw(10) << "speedup" << std::setw(20) << "mismatches chroma" << std::setw(18) << "mismatches half" << "\n";
+
+		for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+		{
+			cv::Mat resized;
+			cv::resize(img, resized, cv::Size(sizes[i], sizes[i]), 0, 0, cv::INTER_AREA);
+			const int iterations = std::max(5, 200 * 320 * 320 / (sizes[i] * sizes[i]));
+
+			cv::Mat blurred, cr, cb, bgrHalf, maskHalf, bgrMask, chromaMask, halfMask;
+			const double bgrMs = measureMs([&](){ cv::GaussianBlur(resized, blurred, cv::Size(5, 5), 0, 0); SkinClassifier::Instance().segment(blurred, bgrMask, thresholds); }, iterations);
+			const double chromaMs = measureMs([&](){ extractSmoothedChroma(resized, cr, cb, false, bgrHalf); thresholdChroma(cr, cb, chromaMask, thresholds); }, iterations);
+			const double halfMs = measureMs([&](){ extractSmoothedChroma(resized, cr, cb, true, bgrHalf); thresholdChroma(cr, cb, maskHalf, thresholds);
+				cv::resize(maskHalf, halfMask, resized.size(), 0, 0, cv::INTER_NEAREST); }, iterations);
+
+			// the chroma modes round differently, only a few pixels at the border of the skin regions should differ
+			cv::Mat diffChroma, diffHalf;
+			cv::compare(bgrMask, chromaMask, diffChroma, cv::CMP_NE);
+			cv::compare(bgrMask, halfMask, diffHalf, cv::CMP_NE);
+
+			std::cout << std::setw(8) << sizes[i] << std::setw(12) << bgrMs << std::setw(14) << chromaMs << std::setw(10) << bgrMs / chromaMs
+				<< std::setw(12) << halfMs << std::setw(10) << bgrMs / halfMs << std::setw(20) << cv::countNonZero(diffChroma) << std::setw(18) << cv::countNonZero(diffHalf) << "\n";
+		}
+	}
+
+
+	void benchmarkMorphology(const cv::Mat& img)
+	{
+		if (img.empty())
+		{
+			throw std::exception("benchmark: input image is empty");
+		}
+
+		const int sizes[] = { 320, 640, 1280, 2560 };
+		cv::Mat small, preprocessed, skin;
+		cv::resize(img, small, cv::Size(320, 320), 0, 0, cv::INTER_AREA);
+		cv::GaussianBlur(small, preprocessed, cv::Size(5, 5), 0, 0);
+		segmentSkin(preprocessed, skin, getSkinThresholds(0, 0));
+
+		std::cout << "erosion of the skin mask: cv::erode (8 bit) vs. bit-packed, the element is scaled with the image (5x5 at 320)\n";
+		std::cout << std::setw(8) << "imgSize" << std::setw(10) << "element" << std::setw(14) << "erode [ms]" << std::setw(14) << "packed [ms]" << std::setw(10) << "speedup"
+			<< std::setw(22) << "packed+convert [ms]" << std::setw(10) << "speedup" << std::setw(12) << "mismatches" << "\n";
+
+		for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+		{
+			cv::Mat mask;
+			cv::resize(skin, mask, cv::Size(sizes[i], sizes[i]), 0, 0, cv::INTER_NEAREST);
+			const int scale = sizes[i] / 320;
+			const cv::Size ksize(5 * scale, 5 * scale);
+			const cv::Point anchor(scale, scale);
+			const cv::Mat element = cv::getStructuringElement(cv::MORPH_RECT, ksize);
+			const int iterations = std::max(5, 200 * 320 * 320 / (sizes[i] * sizes[i]));
+
+			cv::Mat eroded, unpacked;
+			BinaryMask packed, packedEroded;
+			packed.fromMat(mask);
+			const double erodeMs = measureMs([&](){ cv::erode(mask, eroded, element, anchor); }, iterations);
+			const double packedMs = measureMs([&](){ packedEroded.erode(packed, ksize, anchor); }, iterations);
+			const double convertMs = measureMs([&](){ packed.fromMat(mask); packedEroded.erode(packed, ksize, anchor); packedEroded.toMat(unpacked); }, iterations);
+
+			cv::Mat diff;
+			cv::compare(eroded, unpacked, diff, cv::CMP_NE);
+			std::cout << std::setw(8) << sizes[i] << std::setw(10) << ksize.width << std::setw(14) << erodeMs << std::setw(14) << packedMs << std::setw(10) << erodeMs / packedMs
+				<< std::setw(22) << convertMs << std::setw(10) << erodeMs / convertMs << std::setw(12) << cv::countNonZero(diff) << "\n";
+		}
+	}
+
+
+	void benchmarkSkinSegmentation(const cv::Mat& img)
+	{
+		if (img.empty())
+		{
+			throw std::exception("benchmark: input image is empty");
+		}
+
+		const int sizes[] = { 320, 640, 1280, 2560 };
+		const SkinThresholds thresholds = getSkinThresholds(0, 0);
+
+		// the lookup table is created once per threshold setting
+		const int64 tableStart = cv::getTickCount();
+		SkinClassifier::Instance().prepare(thresholds);
+		const double tableMs = (cv::getTickCount() - tableStart) * 1000.0 / cv::getTickFrequency();
+
+		// the trackbar works on the images of the pipeline (320x320)
+		cv::Mat pipelineResized, pipelinePreprocessed;
+		cv::resize(img, pipelineResized, cv::Size(320, 320));
+		cv::GaussianBlur(pipelineResized, pipelinePreprocessed, cv::Size(5, 5), 0, 0);
+		benchmarkColorThresholdUpdate(pipelinePreprocessed, thresholds);
+
+		std::cout << "skin segmentation: reference (cvtColor+split+2x inRange+bitwise_and) vs. fused single pass vs. lookup table\n";
+		std::cout << "creation of the lookup table: " << tableMs << "ms\n";
+		std::cout << std::setw(8) << "imgSize" << std::setw(16) << "reference [ms]" << std::setw(12) << "fused [ms]" << std::setw(10) << "speedup" << std::setw(12) << "table [ms]" << std::setw(10) << "speedup" << std::setw(12) << "mismatches" << "\n";
+
+		for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+		{
+			// same input as in the pipeline: resized and smoothed
+			cv::Mat resized, preprocessed;
+			cv::resize(img, resized, cv::Size(sizes[i], sizes[i]));
+			cv::GaussianBlur(resized, preprocessed, cv::Size(5, 5), 0, 0);
+
+			// roughly the same number of pixels for each size
+			const int iterations = std::max(5, 200 * 320 * 320 / (sizes[i] * sizes[i]));
+
+			cv::Mat referenceMask, fusedMask, tableMask;
+			const double referenceMs = measureMs([&](){ segmentSkinReference(preprocessed, referenceMask, thresholds); }, iterations);
+			const double fusedMs = measureMs([&](){ segmentSkin(preprocessed, fusedMask, thresholds); }, iterations);
+			const double tableLookupMs = measureMs([&](){ SkinClassifier::Instance().segment(preprocessed, tableMask, thresholds); }, iterations);
+
+			cv::Mat diffFused, diffTable;
+			cv::compare(referenceMask, fusedMask, diffFused, cv::CMP_NE);
+			cv::compare(referenceMask, tableMask, diffTable, cv::CMP_NE);
+
+			std::cout << std::setw(8) << sizes[i] << std::setw(16) << referenceMs << std::setw(12) << fusedMs << std::setw(10) << referenceMs / fusedMs
+				<< std::setw(12) << tableLookupMs << std::setw(10) << referenceMs / tableLookupMs << std::setw(12) << cv::countNonZero(diffFused) + cv::countNonZero(diffTable) << "\n";
+		}
+	}
+
+
+
+	/** allocator for cv::Mat which counts the allocations. same memory layout as the default allocator: the data followed by the reference counter */
+	class CountingAllocator : public cv::MatAllocator
+	{
+	public:
+		CountingAllocator() : m_Allocations(0){}
+
+		void allocate(int dims, const int* sizes, int type, int*& refcount, uchar*& datastart, uchar*& data, size_t* step)
+		{
+			++m_Allocations;
+
+			size_t total = CV_ELEM_SIZE(type);
+			for (int i = dims - 1; i >= 0; --i)
+			{
+				step[i] = total;
+				total *= sizes[i];
+			}
+
+			const size_t alignedTotal = cv::alignSize(total, (int)sizeof(*refcount));
+			datastart = data = static_cast<uchar*>(cv::fastMalloc(alignedTotal + sizeof(*refcount)));
+			refcount = reinterpret_cast<int*>(data + alignedTotal);
+			*refcount = 1;
+		}
+
+		void deallocate(int* refcount, uchar* datastart, uchar* data)
+		{
+			cv::fastFree(datastart);
+		}
+
+		int getAllocations() const
+		{
+			return m_Allocations;
+		}
+
+	private:
+		std::atomic<int> m_Allocations; ///< the two images are processed concurrently
+	};
+
+
+	bool checkAllocations(const cv::Mat& front, const cv::Mat& side, const Detection::DetectFaceOptions& options)
+	{
+		// the allocator must outlive the buffers of the workspace
+		CountingAllocator allocator;
+		std::shared_ptr<DetectionWorkspace> workspace = std::make_shared<DetectionWorkspace>();
+		workspace->setAllocator(&allocator);
+
+		// what the check covers: cv::Mat has no process wide allocator (OpenCV 2.4), only the buffers of the workspace are counted
+		std::cout << "counted: the image buffers of the DetectionWorkspace and the capacity of its scratch vectors\n"
+			<< "not counted: temporary Mats inside the pipeline functions (e.g. the rotation matrices of the alignment),"
+			<< " the full resolution images and the transformations (assigned, not allocated by the workspace)\n";
+
+		bool ok = true;
+		const int runs = 5;
+		for (int run = 0; run < runs; ++run)
+		{
+			const int allocationsBefore = allocator.getAllocations();
+			const size_t capacityBefore = workspace->vectorCapacity();
+			{
+				Detection detection(front, side, workspace);
+				detection.detectFaceHeadless(options);
+			}
+			const int allocations = allocator.getAllocations() - allocationsBefore;
+			const size_t capacity = workspace->vectorCapacity();
+
+			// a buffer which got another Mat assigned lost the allocator, its memory would be allocated without being counted
+			const int notCounted = workspace->buffersNotUsingAllocator(&allocator);
+
+			// the first run is the warm-up, afterwards all buffers must be reused
+			const bool steady = allocations == 0 && capacity == capacityBefore && notCounted == 0;
+			std::cout << "run " << run << ": " << allocations << " image buffer allocations, " << notCounted << " image buffers not counted, scratch vectors " << capacity << " bytes"
+				<< (run == 0 ? " (warm-up)" : steady ? "" : " -> ALLOCATED") << "\n";
+			ok = ok && (run == 0 || steady);
+		}
+
+		std::cout << (ok ? "ok: no allocations of the workspace buffers after the warm-up\n" : "failed: workspace buffers are allocated after the warm-up or not counted\n");
+		return ok;
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include "Detection.hpp"
+
+/*
+Micro benchmarks of single pipeline steps. Each benchmark also checks that the optimized implementation gives the same result as the reference.
+*/
+
+namespace Face3D
+{
+	/** \brief  compare the fused skin segmentation with the OpenCV reference implementation (cvtColor, split, inRange, bitwise_and)
+	* \param img BGR input image, it is resized to several working sizes
+	*/
+	void benchmarkSkinSegmentation(const cv::Mat& img);
+
+	/** \brief  compare the preprocessing modes (blur of the BGR image or of the chroma planes, at full or half resolution), each with the skin segmentation that follows it
+	* \param img BGR input image, it is resized to several working sizes
+	*/
+	void benchmarkPreprocessing(const cv::Mat& img);
+
+	/** \brief  compare cv::erode of the 8 bit skin mask with the erosion of the bit-packed mask, with and without the conversions
+	* \param img BGR input image, its skin mask is resized to several working sizes
+	*/
+	void benchmarkMorphology(const cv::Mat& img);
+
+	/** \brief  decode an image in full resolution and reduced (DCT-domain scaling of JPEG files), each followed by the resize to the detection size
+	* \param fn the image file, e.g. a camera photo
+	*/
+	void benchmarkDecode(const std::string& fn);
+
+	/** \brief  run the headless detection several times with the same workspace and count the allocations of its buffers (with a custom cv::MatAllocator)
+	* \param front image of the face from the front
+	* \param side image of the face from the side
+	* \param options detection parameters
+	* \return true if nothing got allocated after the first run
+	*/
+	bool checkAllocations(const cv::Mat& front, const cv::Mat& side, const Detection::DetectFaceOptions& options);
+}
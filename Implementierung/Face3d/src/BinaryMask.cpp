@@ -0,0 +1,454 @@
+#include "BinaryMask.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define FACE3D_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace Face3D
+{
+	namespace
+	{
+		const uint64 allBits = ~static_cast<uint64>(0);
+
+		int popcount(uint64 v)
+		{
+#if defined(__GNUC__)
+			return __builtin_popcountll(v);
+#else
+			// the popcnt instruction isn't available on all cpus of a 32 bit build
+			v = v - ((v >> 1) & 0x5555555555555555ULL);
+			v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+			v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+			return static_cast<int>((v * 0x0101010101010101ULL) >> 56);
+#endif
+		}
+
+		/** index of the lowest set bit, v must not be 0 */
+		int lowestBit(uint64 v)
+		{
+#if defined(__GNUC__)
+			return __builtin_ctzll(v);
+#elif defined(_MSC_VER)
+			unsigned long idx;
+			if (_BitScanForward(&idx, static_cast<unsigned long>(v)))
+			{
+				return static_cast<int>(idx);
+			}
+			_BitScanForward(&idx, static_cast<unsigned long>(v >> 32));
+			return static_cast<int>(idx) + 32;
+#else
+			int idx = 0;
+			while (!((v >> idx) & 1))
+			{
+				++idx;
+			}
+			return idx;
+#endif
+		}
+
+		/** index of the highest set bit, v must not be 0 */
+		int highestBit(uint64 v)
+		{
+#if defined(__GNUC__)
+			return 63 - __builtin_clzll(v);
+#elif defined(_MSC_VER)
+			unsigned long idx;
+			if (_BitScanReverse(&idx, static_cast<unsigned long>(v >> 32)))
+			{
+				return static_cast<int>(idx) + 32;
+			}
+			_BitScanReverse(&idx, static_cast<unsigned long>(v));
+			return static_cast<int>(idx);
+#else
+			int idx = 63;
+			while (!((v >> idx) & 1))
+			{
+				--idx;
+			}
+			return idx;
+#endif
+		}
+
+		/** \brief  shift a row of bits: out(x) = in(x + d), the bits from outside of the row are taken from fill
+		* \param words number of words of the row, in and out must not overlap
+		*/
+		void shiftRow(const uint64* in, uint64* out, int words, int d, uint64 fill)
+		{
+			const int wordShift = (d >= 0 ? d : -d) >> 6;
+			const int bitShift = (d >= 0 ? d : -d) & 63;
+			for (int w = 0; w < words; ++w)
+			{
+				if (d >= 0)
+				{
+					// the bits come from the right, i.e. from the higher words
+					const int src = w + wordShift;
+					const uint64 a = src < words ? in[src] : fill;
+					const uint64 b = src + 1 < words ? in[src + 1] : fill;
+					out[w] = bitShift ? (a >> bitShift) | (b << (64 - bitShift)) : a;
+				}
+				else
+				{
+					const int src = w - wordShift;
+					const uint64 a = src >= 0 ? in[src] : fill;
+					const uint64 b = src - 1 >= 0 ? in[src - 1] : fill;
+					out[w] = bitShift ? (a << bitShift) | (b >> (64 - bitShift)) : a;
+				}
+			}
+		}
+
+		inline void combineRows(uint64* inout, const uint64* other, int words, bool isAnd)
+		{
+			if (isAnd)
+			{
+				for (int w = 0; w < words; ++w)
+				{
+					inout[w] &= other[w];
+				}
+			}
+			else
+			{
+				for (int w = 0; w < words; ++w)
+				{
+					inout[w] |= other[w];
+				}
+			}
+		}
+
+		/** \brief  combine each bit with its neighbours in place: the window [x, x + length) for length > 0, (x + length, x] for length < 0.
+		* the windows of length 1, 2, 4, ... are combined with themselves, the rest with an overlapping window, log2(length) shifts.
+		* \param tmp scratch row
+		*/
+		void combineWindow(uint64* row, uint64* tmp, int words, int length, uint64 fill, bool isAnd)
+		{
+			const int sign = length >= 0 ? 1 : -1;
+			length *= sign;
+			int done = 1;
+			while (2 * done <= length)
+			{
+				shiftRow(row, tmp, words, sign*done, fill);
+				combineRows(row, tmp, words, isAnd);
+				done *= 2;
+			}
+			if (done < length)
+			{
+				shiftRow(row, tmp, words, sign*(length - done), fill);
+				combineRows(row, tmp, words, isAnd);
+			}
+		}
+	}
+
+
+
+	void BinaryMask::create(int rows, int cols)
+	{
+		m_Rows = rows;
+		m_Cols = cols;
+		m_WordsPerRow = (cols + 63) >> 6;
+		m_Bits.resize(static_cast<size_t>(m_Rows)*m_WordsPerRow);
+	}
+
+
+
+	void BinaryMask::fromMat(const cv::Mat& binary)
+	{
+		CV_Assert(binary.type() == CV_8UC1);
+
+		create(binary.rows, binary.cols);
+		for (int y = 0; y < m_Rows; ++y)
+		{
+			const uchar* src = binary.ptr<uchar>(y);
+			uint64* dst = row(y);
+			int x = 0;
+#ifdef FACE3D_USE_SSE2
+			// 16 pixels -> 16 bits with a single compare and movemask
+			const __m128i zero = _mm_setzero_si128();
+			for (; x + 64 <= m_Cols; x += 64)
+			{
+				uint64 word = 0;
+				for (int i = 0; i < 4; ++i)
+				{
+					const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 16 * i));
+					const int isZero = _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+					word |= static_cast<uint64>(~isZero & 0xFFFF) << (16 * i);
+				}
+				dst[x >> 6] = word;
+			}
+#endif
+			for (; x < m_Cols; x += 64)
+			{
+				uint64 word = 0;
+				const int n = std::min(64, m_Cols - x);
+				for (int i = 0; i < n; ++i)
+				{
+					word |= static_cast<uint64>(src[x + i] != 0) << i;
+				}
+				dst[x >> 6] = word;
+			}
+		}
+	}
+
+
+
+	void BinaryMask::toMat(cv::Mat& mask, uchar value) const
+	{
+		mask.create(m_Rows, m_Cols, CV_8UC1);
+		for (int y = 0; y < m_Rows; ++y)
+		{
+			const uint64* src = row(y);
+			uchar* dst = mask.ptr<uchar>(y);
+			for (int w = 0; w < m_WordsPerRow; ++w)
+			{
+				const int x = w << 6;
+				const int n = std::min(64, m_Cols - x);
+				const uint64 word = src[w];
+				if (word == 0 || (n == 64 && word == allBits))
+				{
+					// most words of a skin mask are completely inside or outside
+					memset(dst + x, word ? value : 0, n);
+					continue;
+				}
+				for (int i = 0; i < n; ++i)
+				{
+					dst[x + i] = ((word >> i) & 1) ? value : 0;
+				}
+			}
+		}
+	}
+
+
+
+	void BinaryMask::erode(const BinaryMask& src, cv::Size ksize, cv::Point anchor)
+	{
+		morphology(src, ksize, anchor, true);
+	}
+
+
+
+	void BinaryMask::dilate(const BinaryMask& src, cv::Size ksize, cv::Point anchor)
+	{
+		morphology(src, ksize, anchor, false);
+	}
+
+
+
+	void BinaryMask::morphology(const BinaryMask& src, cv::Size ksize, cv::Point anchor, bool isErode)
+	{
+		CV_Assert(ksize.width > 0 && ksize.height > 0);
+		anchor.x = anchor.x < 0 ? ksize.width / 2 : anchor.x;
+		anchor.y = anchor.y < 0 ? ksize.height / 2 : anchor.y;
+		CV_Assert(anchor.x < ksize.width && anchor.y < ksize.height);
+
+		// the border doesn't change the result: pixels outside of the image are foreground for the erosion and background for the dilation
+		const uint64 fill = isErode ? allBits : 0;
+		const int rows = src.m_Rows;
+		const int words = src.m_WordsPerRow;
+		const uint64 padding = src.paddingMask();
+
+		m_Tmp.resize(4 * static_cast<size_t>(words));
+		uint64* a = m_Tmp.data();
+		uint64* b = a + words;
+		uint64* prefix = b + words;
+		uint64* fillRow = prefix + words;
+		std::fill(fillRow, fillRow + words, fill);
+
+		// along the rows: the window [x - anchor, x - anchor + width) is split into [x - anchor, x] and [x, x - anchor + width),
+		// so the bits shifted in from outside of the row always belong to windows which are completely outside
+		m_RowPass.resize(static_cast<size_t>(rows)*words);
+		for (int y = 0; y < rows; ++y)
+		{
+			memcpy(a, src.row(y), words*sizeof(uint64));
+			if (words > 0)
+			{
+				a[words - 1] |= padding & fill;
+			}
+			uint64* dst = m_RowPass.data() + static_cast<size_t>(y)*words;
+			memcpy(dst, a, words*sizeof(uint64));
+			combineWindow(a, b, words, ksize.width - anchor.x, fill, isErode);
+			combineWindow(dst, b, words, -(anchor.x + 1), fill, isErode);
+			combineRows(dst, a, words, isErode);
+		}
+
+		// along the columns (van Herk / Gil-Werman): the rows g(i) = rowPass(i - anchor.y) are split into blocks of height rows.
+		// the result of row y is suffix(y) combined with prefix(y + height - 1), two combinations per row for any height.
+		create(rows, src.m_Cols);
+		const int height = ksize.height;
+		const int n = rows + height - 1;
+		const uint64* rowPass = m_RowPass.data();
+		auto g = [&](int i) -> const uint64*
+		{
+			const int srcRow = i - anchor.y;
+			return srcRow >= 0 && srcRow < rows ? rowPass + static_cast<size_t>(srcRow)*words : fillRow;
+		};
+
+		m_Suffix.resize(static_cast<size_t>(n)*words);
+		for (int i = n - 1; i >= 0; --i)
+		{
+			uint64* suffix = m_Suffix.data() + static_cast<size_t>(i)*words;
+			memcpy(suffix, g(i), words*sizeof(uint64));
+			if ((i + 1) % height != 0 && i + 1 < n)
+			{
+				combineRows(suffix, suffix + words, words, isErode);
+			}
+		}
+
+		for (int i = 0; i < n; ++i)
+		{
+			if (i % height == 0)
+			{
+				memcpy(prefix, g(i), words*sizeof(uint64));
+			}
+			else
+			{
+				combineRows(prefix, g(i), words, isErode);
+			}
+
+			const int y = i - (height - 1);
+			if (y >= 0)
+			{
+				uint64* dst = row(y);
+				memcpy(dst, m_Suffix.data() + static_cast<size_t>(y)*words, words*sizeof(uint64));
+				combineRows(dst, prefix, words, isErode);
+			}
+		}
+
+		clearPadding();
+	}
+
+
+
+	void BinaryMask::bitwiseAnd(const BinaryMask& a, const BinaryMask& b)
+	{
+		CV_Assert(a.m_Rows == b.m_Rows && a.m_Cols == b.m_Cols);
+
+		create(a.m_Rows, a.m_Cols);
+		for (size_t i = 0; i < m_Bits.size(); ++i)
+		{
+			m_Bits[i] = a.m_Bits[i] & b.m_Bits[i];
+		}
+	}
+
+
+
+	void BinaryMask::bitwiseOr(const BinaryMask& a, const BinaryMask& b)
+	{
+		CV_Assert(a.m_Rows == b.m_Rows && a.m_Cols == b.m_Cols);
+
+		create(a.m_Rows, a.m_Cols);
+		for (size_t i = 0; i < m_Bits.size(); ++i)
+		{
+			m_Bits[i] = a.m_Bits[i] | b.m_Bits[i];
+		}
+	}
+
+
+
+	int BinaryMask::area() const
+	{
+		int res = 0;
+		for (size_t i = 0; i < m_Bits.size(); ++i)
+		{
+			res += popcount(m_Bits[i]);
+		}
+		return res;
+	}
+
+
+
+	int BinaryMask::leftmost(int y, int xBegin, int xEnd) const
+	{
+		xBegin = std::max(xBegin, 0);
+		xEnd = std::min(xEnd, m_Cols);
+		if (xBegin >= xEnd)
+		{
+			return -1;
+		}
+
+		const uint64* bits = row(y);
+		const int lastWord = (xEnd - 1) >> 6;
+		uint64 word = bits[xBegin >> 6] & (allBits << (xBegin & 63));
+		for (int w = xBegin >> 6; ; word = bits[++w])
+		{
+			if (w == lastWord)
+			{
+				word &= allBits >> (63 - ((xEnd - 1) & 63));
+			}
+			if (word)
+			{
+				return (w << 6) + lowestBit(word);
+			}
+			if (w == lastWord)
+			{
+				return -1;
+			}
+		}
+	}
+
+
+
+	int BinaryMask::rightmost(int y, int xBegin, int xEnd) const
+	{
+		xBegin = std::max(xBegin, 0);
+		xEnd = std::min(xEnd, m_Cols);
+		if (xBegin >= xEnd)
+		{
+			return -1;
+		}
+
+		const uint64* bits = row(y);
+		const int firstWord = xBegin >> 6;
+		uint64 word = bits[(xEnd - 1) >> 6] & (allBits >> (63 - ((xEnd - 1) & 63)));
+		for (int w = (xEnd - 1) >> 6; ; word = bits[--w])
+		{
+			if (w == firstWord)
+			{
+				word &= allBits << (xBegin & 63);
+			}
+			if (word)
+			{
+				return (w << 6) + highestBit(word);
+			}
+			if (w == firstWord)
+			{
+				return -1;
+			}
+		}
+	}
+
+
+
+	size_t BinaryMask::capacity() const
+	{
+		return (m_Bits.capacity() + m_RowPass.capacity() + m_Suffix.capacity() + m_Tmp.capacity())*sizeof(uint64);
+	}
+
+
+
+	uint64 BinaryMask::paddingMask() const
+	{
+		const int used = m_Cols & 63;
+		return used ? allBits << used : 0;
+	}
+
+
+
+	void BinaryMask::clearPadding()
+	{
+		const uint64 padding = paddingMask();
+		if (!padding)
+		{
+			return;
+		}
+		for (int y = 0; y < m_Rows; ++y)
+		{
+			row(y)[m_WordsPerRow - 1] &= ~padding;
+		}
+	}
+}
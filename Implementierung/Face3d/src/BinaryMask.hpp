@@ -0,0 +1,92 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+/*
+Binary mask with one bit per pixel, packed into 64 bit words (bit i of word w is the pixel x = 64*w + i).
+Morphology and logic operations work on whole words, i.e. on 64 pixels at once, and the mask needs an eighth of the memory of a CV_8U mask.
+Conversion from and to cv::Mat is only needed at the edges of the pipeline.
+*/
+
+namespace Face3D
+{
+	/** bit-packed binary mask. the bits behind the last column of a row are always 0. operations on masks of the same size allocate nothing. */
+	class BinaryMask
+	{
+	public:
+		BinaryMask() : m_Rows(0), m_Cols(0), m_WordsPerRow(0){}
+
+		/** \brief  resize the mask, the content is undefined afterwards */
+		void create(int rows, int cols);
+
+		/** \brief  pack an 8 bit mask
+		* \param binary 8 bit mask, everything != 0 is foreground
+		*/
+		void fromMat(const cv::Mat& binary);
+
+		/** \brief  unpack into an 8 bit mask
+		* \param mask resulting mask, same size as this one
+		* \param value value of the foreground pixels
+		*/
+		void toMat(cv::Mat& mask, uchar value = 255) const;
+
+		int rows() const { return m_Rows; }
+		int cols() const { return m_Cols; }
+		int wordsPerRow() const { return m_WordsPerRow; }
+
+		const uint64* row(int y) const { return m_Bits.data() + static_cast<size_t>(y)*m_WordsPerRow; }
+		uint64* row(int y) { return m_Bits.data() + static_cast<size_t>(y)*m_WordsPerRow; }
+
+		bool at(int y, int x) const { return ((row(y)[x >> 6] >> (x & 63)) & 1) != 0; }
+
+		/** \brief  erosion with a rectangle, same result as cv::erode with a rectangular structuring element and the default border
+		* (the pixels outside of the image don't erode). the source may be this mask.
+		* \param src mask to erode
+		* \param ksize size of the rectangle
+		* \param anchor anchor inside the rectangle, (-1, -1) is the center
+		*/
+		void erode(const BinaryMask& src, cv::Size ksize, cv::Point anchor = cv::Point(-1, -1));
+
+		/** \brief  dilation with a rectangle, same result as cv::dilate with a rectangular structuring element and the default border. the source may be this mask. */
+		void dilate(const BinaryMask& src, cv::Size ksize, cv::Point anchor = cv::Point(-1, -1));
+
+		/** \brief  pixelwise and / or of two masks of the same size, the result may be one of the sources */
+		void bitwiseAnd(const BinaryMask& a, const BinaryMask& b);
+		void bitwiseOr(const BinaryMask& a, const BinaryMask& b);
+
+		/** number of foreground pixels */
+		int area() const;
+
+		/** \brief  leftmost foreground pixel of a row inside of [xBegin, xEnd)
+		* \return the x coordinate, -1 if there is no foreground pixel
+		*/
+		int leftmost(int y, int xBegin, int xEnd) const;
+		int leftmost(int y) const { return leftmost(y, 0, m_Cols); }
+
+		/** \brief  rightmost foreground pixel of a row inside of [xBegin, xEnd)
+		* \return the x coordinate, -1 if there is no foreground pixel
+		*/
+		int rightmost(int y, int xBegin, int xEnd) const;
+		int rightmost(int y) const { return rightmost(y, 0, m_Cols); }
+
+		/** memory reserved by the bits and the scratch buffers in bytes, it doesn't grow once the mask is warmed up */
+		size_t capacity() const;
+
+	private:
+		/** erosion (isErode) or dilation: separable, first along the rows, then along the columns */
+		void morphology(const BinaryMask& src, cv::Size ksize, cv::Point anchor, bool isErode);
+
+		/** bits behind the last column */
+		uint64 paddingMask() const;
+		void clearPadding();
+
+		int m_Rows, m_Cols, m_WordsPerRow;
+		std::vector<uint64> m_Bits; ///< the rows one after the other
+
+		/** scratch buffers of the morphology */
+		std::vector<uint64> m_RowPass; ///< result of the pass along the rows
+		std::vector<uint64> m_Suffix; ///< van Herk / Gil-Werman: combination of the rows from each row to the end of its block
+		std::vector<uint64> m_Tmp; ///< a few rows for the shifts and the prefix
+	};
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace Face3D
+{
+	/** bounded queue between the stages of a pipeline: push blocks while the queue is full, pop blocks while it is empty.
+	* after close() the remaining items can still be popped, then pop returns false.
+	*/
+	template <class T>
+	class BlockingQueue
+	{
+	public:
+		explicit BlockingQueue(size_t capacity) : m_Capacity(capacity ? capacity : 1), m_Closed(false){}
+
+		/** \brief  add an item, waits until there is space
+		* \return false if the queue is closed, the item is dropped
+		*/
+		bool push(T item)
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_NotFull.wait(lock, [this](){ return m_Items.size() < m_Capacity || m_Closed; });
+			if (m_Closed)
+			{
+				return false;
+			}
+			m_Items.push_back(std::move(item));
+			m_NotEmpty.notify_one();
+			return true;
+		}
+
+		/** \brief  take the oldest item, waits until there is one
+		* \return false if the queue is closed and empty
+		*/
+		bool pop(T& item)
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_NotEmpty.wait(lock, [this](){ return !m_Items.empty() || m_Closed; });
+			if (m_Items.empty())
+			{
+				return false;
+			}
+			item = std::move(m_Items.front());
+			m_Items.pop_front();
+			m_NotFull.notify_one();
+			return true;
+		}
+
+		/** no more items will be pushed, wakes up all waiting threads */
+		void close()
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Closed = true;
+			m_NotEmpty.notify_all();
+			m_NotFull.notify_all();
+		}
+
+	private:
+		BlockingQueue(const BlockingQueue&);
+		BlockingQueue& operator=(const BlockingQueue&);
+
+		std::deque<T> m_Items;
+		size_t m_Capacity;
+		bool m_Closed;
+		std::mutex m_Mutex;
+		std::condition_variable m_NotEmpty, m_NotFull;
+	};
+}
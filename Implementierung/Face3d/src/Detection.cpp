@@ -1,28 +1,93 @@
 #include "Detection.hpp"
 #include "Common.hpp"
+#include "SkinSegmentation.hpp"
+#include "SkinClassifier.hpp"
+#include "RegionLabelling.hpp"
+#include "StageTimer.hpp"
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <ctime>
+#include <future>
+#include <algorithm>
+#include <cfloat>
 
 
 namespace Face3D
 {
 
 
-	Detection::Detection(const cv::Mat& front, const cv::Mat& side)
+	Detection::Detection(const cv::Mat& front, const cv::Mat& side, std::shared_ptr<DetectionWorkspace> workspace)
+		: m_Workspace(workspace)
+		, m_FullRes(workspace->fullRes)
+		, m_Originals(workspace->originals)
+		, m_Preprocessed(workspace->preprocessed)
+		, m_ChromaCr(workspace->chromaCr)
+		, m_ChromaCb(workspace->chromaCb)
+		, m_FaceExtracted(workspace->faceExtracted)
+		, m_FaceMask(workspace->faceMask)
+		, m_AlignTransform(workspace->alignTransform)
+		, m_Textures(workspace->textures)
 	{		
 		/*
 		we expect the images to be square (e.g. 640x640)
-		we will resize the input images to a fixed size of 320x320
+		the facial components are detected in a scaled down copy (320x320 by default), the textures are taken from the full resolution images.
+		the face geometry always uses the coordinate system of a 320x320 image, independent of the detection size.
 		*/
 
-		m_Originals.resize(2);
+		if (front.empty() || side.empty())
+		{
+			throw std::exception("front or side image is empty");
+		}
+
+		// the per image buffers are already allocated by the workspace, the two images are processed concurrently afterwards
 		
+		// no copy, the images are only read
 		assert(front.size().width == front.size().height);
-		cv::resize(front, m_Originals[frontImgNr], cv::Size(imgSize, imgSize));
+		m_FullRes[frontImgNr] = front;
 
 		assert(side.size().width == side.size().height);
-		cv::resize(side, m_Originals[sideImgNr], cv::Size(imgSize, imgSize));
+		m_FullRes[sideImgNr] = side;
+
+		m_PreprocessedValid[frontImgNr] = m_PreprocessedValid[sideImgNr] = false;
+	}
+
+
+
+	void Detection::createDetectionImages(size_t detectionSize)
+	{
+		ScopedStageTimer timer("createDetectionImages");
+
+		if (detectionSize < 32)
+		{
+			throw std::exception("detection size must be at least 32");
+		}
+
+		// INTER_AREA averages all pixels which fall into a destination pixel, so there is no aliasing even for large scale factors
+		m_DetectionSize = detectionSize;
+		for (size_t imgNr = 0; imgNr < 2; ++imgNr)
+		{
+			cv::resize(m_FullRes[imgNr], m_Originals[imgNr], cv::Size(m_DetectionSize, m_DetectionSize), 0, 0, cv::INTER_AREA);
+		}
+	}
+
+
+
+	cv::Mat Detection::getScaleTransform(double sx, double sy)
+	{
+		// pixel centers are mapped onto each other, same as in cv::resize: dst = (src + 0.5) * s - 0.5
+		cv::Mat scaleMat = cv::Mat::eye(3, 3, CV_64F);
+		scaleMat.at<double>(0, 0) = sx;
+		scaleMat.at<double>(0, 2) = 0.5*sx - 0.5;
+		scaleMat.at<double>(1, 1) = sy;
+		scaleMat.at<double>(1, 2) = 0.5*sy - 0.5;
+		return scaleMat;
+	}
+
+
+
+	cv::Mat Detection::getFullResToGeometryTransform(size_t imgNr) const
+	{
+		return getScaleTransform(double(imgSize) / m_FullRes[imgNr].cols, double(imgSize) / m_FullRes[imgNr].rows);
 	}
 
 
@@ -30,15 +95,72 @@ namespace Face3D
 	Detection::DetectFaceResult Detection::detectFace()
 	{
 		// execute the pipeline
+		createDetectionImages(imgSize);
 		doPreprocessing();	
 		doFaceExtractionGUI();
 		doFacialComponentsExtraction();
 		doMatchCoordinates();				
 		createTexturesAndShowResultsGUI();
 
-		// prepare result and return it
+		return getResult();
+	}
+
+
+
+	Detection::DetectFaceResult Detection::detectFaceHeadless(const DetectFaceOptions& options)
+	{
+		ScopedStageTimer timer("detectFaceHeadless");
+
+		// no windows at all, not even the debug output
+		m_Headless = true;
+		m_Concurrent = options.concurrent;
+		m_UseLookupTable = options.useLookupTable;
+		m_Preprocessing = options.preprocessing;
+
+		// take the values which would otherwise be selected in the gui
+		setColorThreshold(options.colorThreshold);
+		m_AddTextureTop = options.addTextureTop;
+		m_AddTextureBottom = options.addTextureBottom;
+		createDetectionImages(options.detectionSize);
+
+		// execute the pipeline: front and side image are independent until the coordinates get matched
+		runForBothImages([this](size_t imgNr)
+		{
+			doPreprocessing(imgNr);
+			doFaceExtraction(imgNr);
+			doFacialComponentsExtraction(imgNr);
+		});
+		doMatchCoordinates();
+		createTextures();
+
+		return getResult();
+	}
+
+
+
+	Detection::DetectFaceResult Detection::createResultFromPoints(const FaceGeometry& detectedGeometry, const DetectFaceOptions& options)
+	{
+		ScopedStageTimer timer("createResultFromPoints");
+
+		m_Headless = true;
+		m_AddTextureTop = options.addTextureTop;
+		m_AddTextureBottom = options.addTextureBottom;
+
+		// only the last steps of the pipeline, the textures are taken from the full resolution images
+		m_FaceGeometry = detectedGeometry;
+		doMatchCoordinates();
+		createTextures();
+
+		return getResult();
+	}
+
+
+
+	Detection::DetectFaceResult Detection::getResult() const
+	{
 		DetectFaceResult res;
 		res.faceGeometry = m_FaceGeometry;
+		res.detectedGeometry = m_FaceGeometryDetected;
 		res.textureFront = m_Textures[frontImgNr];
 		res.textureSide = m_Textures[sideImgNr];
 		return res;
@@ -46,103 +168,154 @@ namespace Face3D
 
 
 
-	void Detection::doPreprocessing()
+	FaceData Detection::DetectFaceResult::toFaceData() const
 	{
-		m_Preprocessed.resize(2);
-		for (size_t i = 0; i < m_Originals.size(); ++i)
-		{
-			cv::Mat resizedImg;
-			cv::GaussianBlur(m_Originals[i], m_Preprocessed[i], cv::Size(5, 5), 0, 0);
-		}		
+		CV_Assert(textureFront.type() == CV_8UC3 && textureSide.type() == CV_8UC3);
+
+		FaceData res;
+		res.geometry = faceGeometry.toRecord();
+		res.textureFront = ImageView(textureFront.data, textureFront.cols, textureFront.rows, textureFront.step);
+		res.textureSide = ImageView(textureSide.data, textureSide.cols, textureSide.rows, textureSide.step);
+		return res;
 	}
 
 
-	void Detection::doFaceExtraction()
+
+	void Detection::runForBothImages(const std::function<void(size_t)>& stage)
 	{
-		// clear previous result because this function could be called multiple times from the gui
-		m_FaceExtracted.clear();
+		// the debug windows must be shown one after the other from the main thread
+#ifndef NDEBUG
+		const bool concurrent = m_Concurrent && m_Headless;
+#else
+		const bool concurrent = m_Concurrent;
+#endif
+
+		if (!concurrent)
+		{
+			stage(frontImgNr);
+			stage(sideImgNr);
+			return;
+		}
 
-		for (size_t i = 0; i < m_Preprocessed.size(); ++i)
+		// side image in a second thread, front image in this one
+		std::future<void> sideResult = std::async(std::launch::async, stage, sideImgNr);
+		try
 		{
-			// to YCrCb colorspace
-			cv::Mat ycrcb;
-			cv::cvtColor(m_Preprocessed[i], ycrcb, CV_BGR2YCrCb);
+			stage(frontImgNr);
+		}
+		catch (...)
+		{
+			// don't leave the other thread running on our data
+			sideResult.wait();
+			throw;
+		}
 
-			// split color channels into seperate grayscale images
-			std::vector<cv::Mat> channels;
-			cv::split(ycrcb, channels);
+		// rethrows exceptions from the side image
+		sideResult.get();
+	}
 
-			// threshold cr and cb color channel
-			cv::Mat crThres, cbThres;
-			cv::inRange(channels[1], cv::Scalar(143 + m_OffsetCR), cv::Scalar(173 + m_OffsetCR), crThres);
-			cv::inRange(channels[2], cv::Scalar(77 + m_OffsetCB), cv::Scalar(125 + m_OffsetCB), cbThres);		 // REMARK: tweaked the values a bit to get better results
 
-			// combine result with bitwise and
-			cv::Mat combinedThres;
-			cv::bitwise_and(crThres, cbThres, combinedThres);
 
-			// do some morphological erode (enlarges black regions)
-			// REMARK: this is not in the original paper but helps to find the facial components 
-			cv::Mat structElement = cv::getStructuringElement
-			(
-				cv::MORPH_RECT
-				, cv::Size(5, 5)
-				, cv::Point(1, 1)
-			);
+	void Detection::doPreprocessing()
+	{
+		runForBothImages([this](size_t imgNr){ doPreprocessing(imgNr); });
+	}
 
-			//cv::dilate(combinedThres, combinedThres, structElement);
-			cv::erode(combinedThres, combinedThres, structElement);		
-			
-			// add to result
-			m_FaceExtracted.push_back(combinedThres);
 
-			// dbgShow(m_FaceExtracted[i], "doFaceExtraction",i); this is already shown in the gui
+	void Detection::doPreprocessing(size_t imgNr)
+	{
+		ScopedStageTimer timer("preprocessing", static_cast<int>(imgNr));
+
+		m_PreprocessedValid[imgNr] = false;
+		if (m_Preprocessing == PreprocessBgr)
+		{
+			getPreprocessed(imgNr);
+
+			// the cached chroma planes are outdated now
+			m_ChromaCr[imgNr].release();
+			m_ChromaCb[imgNr].release();
+			return;
 		}
-	}
 
+		// the segmentation only needs the chroma planes: convert first and blur two planes instead of three channels
+		extractSmoothedChroma(m_Originals[imgNr], m_ChromaCr[imgNr], m_ChromaCb[imgNr], m_Preprocessing == PreprocessChromaHalf, m_Workspace->originalsHalf[imgNr]);
+	}
 
 
-	void Detection::doFacialComponentsExtraction()
+	const cv::Mat& Detection::getPreprocessed(size_t imgNr)
 	{
-		/*
-		REMARK: as the original paper does not say too much how specific components are found, we will implement this step according to Akimoto:
-		the inner regions (the black holes in the white face) are used and are classified according to some very simple rules:
-		-> size
-		-> position (relative to center of gravity of face) 
-		*/
-		
-		for (size_t i = 0; i < m_FaceExtracted.size(); ++i)
+		if (!m_PreprocessedValid[imgNr])
 		{
-			// find the contours (bounded binary regions)
-			std::vector<std::vector<cv::Point> > contours;
-			std::vector<cv::Vec4i> hierarchy;
+			cv::GaussianBlur(m_Originals[imgNr], m_Preprocessed[imgNr], cv::Size(5, 5), 0, 0);
+			m_PreprocessedValid[imgNr] = true;
+		}
+		return m_Preprocessed[imgNr];
+	}
 
-			// copy original as findContours changes image
-			cv::Mat tmp; 
-			m_FaceExtracted[i].copyTo(tmp);
 
-			cv::findContours(tmp, contours, hierarchy, CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE, cv::Point(0, 0));
+	void Detection::doFaceExtraction()
+	{
+		runForBothImages([this](size_t imgNr){ doFaceExtraction(imgNr); });
+	}
 
-			// indices of the potential face components
-			std::vector<size_t> potentialComponentIndices = findRegions(contours,hierarchy,RegionTypeInside); // indices of facial components
-			std::vector<size_t> potentialSkinIndices = findRegions(contours, hierarchy, RegionTypeOutside); // indices of face (skin) region
 
-			// extract information for those regions
-			std::vector<ContourInfo> potentialComponentContourInfo = extractContourInfo(contours, potentialComponentIndices); // facial components
-			std::vector<ContourInfo> potentialSkinContourInfo = extractContourInfo(contours, potentialSkinIndices); // face (skin) region			
+	void Detection::doFaceExtraction(size_t imgNr)
+	{
+		ScopedStageTimer timer("faceExtraction", static_cast<int>(imgNr));
 
-			if (frontImgNr==i)
-			{
-				doFacialComponentsExtractionFront(m_FaceGeometry, potentialComponentContourInfo, potentialSkinContourInfo);
-			}
-			else if (sideImgNr==i)
-			{
-				doFacialComponentsExtractionSide(m_FaceGeometry, potentialComponentContourInfo, potentialSkinContourInfo);
-			}						
+		// threshold cr and cb color channel in a single pass (no YCrCb image, no channel split)
+		cv::Mat& combinedThres = m_Workspace->skin[imgNr];
+		const SkinThresholds thresholds = getSkinThresholds(m_OffsetCR, m_OffsetCB);
+		if (!m_Headless && m_ChromaCr[imgNr].empty())
+		{
+			// the gui calls this for every change of the color threshold trackbar: convert once, afterwards just threshold and erode
+			extractChroma(getPreprocessed(imgNr), m_ChromaCr[imgNr], m_ChromaCb[imgNr]);
 		}
 
+		if (!m_ChromaCr[imgNr].empty() && m_ChromaCr[imgNr].size() != m_Originals[imgNr].size())
+		{
+			// chroma planes at half resolution: threshold a quarter of the pixels, then scale the mask up
+			cv::Mat& skinHalf = m_Workspace->skinHalf[imgNr];
+			thresholdChroma(m_ChromaCr[imgNr], m_ChromaCb[imgNr], skinHalf, thresholds);
+			cv::resize(skinHalf, combinedThres, m_Originals[imgNr].size(), 0, 0, cv::INTER_NEAREST);
+		}
+		else if (!m_ChromaCr[imgNr].empty())
+		{
+			// smoothed chroma planes from the preprocessing or cached by the gui
+			thresholdChroma(m_ChromaCr[imgNr], m_ChromaCb[imgNr], combinedThres, thresholds);
+		}
+		else if (m_UseLookupTable)
+		{
+			// a single table lookup per pixel, the table is created once for each threshold setting
+			SkinClassifier::Instance().segment(getPreprocessed(imgNr), combinedThres, thresholds);
+		}
+		else
+		{
+			segmentSkin(getPreprocessed(imgNr), combinedThres, thresholds);
+		}
 
+		// do some morphological erode (enlarges black regions)
+		// REMARK: this is not in the original paper but helps to find the facial components 
+		const cv::Mat& structElement = m_Workspace->erodeElement; // 5x5 rect, anchor (1,1)
 
+		// replace previous result because this function could be called multiple times from the gui
+		//cv::dilate(combinedThres, m_FaceExtracted[imgNr], structElement);
+		cv::erode(combinedThres, m_FaceExtracted[imgNr], structElement);		
+
+		// dbgShow(m_FaceExtracted[imgNr], "doFaceExtraction",imgNr); this is already shown in the gui
+	}
+
+
+
+	void Detection::doFacialComponentsExtraction()
+	{
+		runForBothImages([this](size_t imgNr){ doFacialComponentsExtraction(imgNr); });
+
+		// debug output only
+		if (m_Headless)
+		{
+			return;
+		}
 
 		// draw resulting 2d centroids
 		// 1. front
@@ -168,40 +341,282 @@ namespace Face3D
 	}
 
 
-	void Detection::doFacialComponentsExtractionFront(FaceGeometry& faceGeometry, const std::vector<ContourInfo>& componentContourInfo, const std::vector<ContourInfo>& faceContourInfo)
+	void Detection::doFacialComponentsExtraction(size_t imgNr)
+	{
+		ScopedStageTimer timer("componentExtraction", static_cast<int>(imgNr));
+
+		/*
+		REMARK: as the original paper does not say too much how specific components are found, we will implement this step according to Akimoto:
+		the inner regions (the black holes in the white face) are used and are classified according to some very simple rules:
+		-> size
+		-> position (relative to center of gravity of face) 
+		*/
+
+		// everything below only looks at the region around the face, background clutter is ignored
+		const cv::Rect& roi = m_FaceRoi[imgNr] = findFaceRoi(imgNr);
+
+		// label the binary regions: area and center of gravity of the skin regions and of the holes inside of them in one sweep
+		RegionLabeller& labeller = m_Workspace->labellers[imgNr];
+		cv::Mat& labels = m_Workspace->labels[imgNr];
+		std::vector<RegionInfo>& potentialSkinInfo = m_Workspace->skinRegions[imgNr]; // face (skin) region
+		std::vector<RegionInfo>& potentialComponentInfo = m_Workspace->componentRegions[imgNr]; // facial components
+		labeller.labelRegions(m_FaceExtracted[imgNr](roi), labels, potentialSkinInfo, potentialComponentInfo);
+		if (!isFaceInsideRoi(imgNr, roi, potentialSkinInfo))
+		{
+			// the coarse pass may have chosen a sparse background region: label the whole image instead
+			m_FaceRoi[imgNr] = cv::Rect(0, 0, m_FaceExtracted[imgNr].cols, m_FaceExtracted[imgNr].rows);
+			labeller.labelRegions(m_FaceExtracted[imgNr], labels, potentialSkinInfo, potentialComponentInfo);
+		}
+
+		// create face mask: the biggest skin region with everything inside of it
+		m_FaceMask[imgNr].create(m_FaceExtracted[imgNr].size(), CV_8U);
+		m_FaceMask[imgNr].setTo(0);
+		if (!potentialSkinInfo.empty())
+		{
+			const RegionInfo& face = *std::min_element(potentialSkinInfo.begin(), potentialSkinInfo.end());
+			cv::Mat faceMaskRoi = m_FaceMask[imgNr](roi);
+			labeller.getRegionMask(labels, face, potentialSkinInfo, potentialComponentInfo, true, faceMaskRoi);
+		}
+
+		// only the biggest regions are used, the rest doesn't need to be sorted
+		keepBiggestRegions(potentialComponentInfo, 3);
+		keepBiggestRegions(potentialSkinInfo, 1);
+		translateRegions(potentialComponentInfo, roi.tl());
+		translateRegions(potentialSkinInfo, roi.tl());
+
+		// front and side write to different points of the face geometry, so this is fine when running concurrently
+		if (frontImgNr==imgNr)
+		{
+			doFacialComponentsExtractionFront(m_FaceGeometry, labels, potentialComponentInfo, potentialSkinInfo);
+		}
+		else if (sideImgNr==imgNr)
+		{
+			doFacialComponentsExtractionSide(m_FaceGeometry, labels, potentialComponentInfo, potentialSkinInfo);
+		}
+
+		// detection size -> coordinate system of the face geometry, then use the full resolution to get more accurate face borders
+		toGeometryCoordinates(imgNr);
+		refineFaceBorders(imgNr);
+	}
+
+
+
+	cv::Rect Detection::findFaceRoi(size_t imgNr)
+	{
+		// cheap pass on a coarse copy: INTER_AREA averages the blocks, so a coarse pixel is foreground if any pixel of its block is.
+		// a connected region stays connected in the coarse image, therefore the face is inside of the biggest coarse region.
+		const int coarseScale = 4;
+		const cv::Mat& faceExtracted = m_FaceExtracted[imgNr];
+		const cv::Rect imgRect(0, 0, faceExtracted.cols, faceExtracted.rows);
+		cv::Mat& coarse = m_Workspace->coarse[imgNr];
+		cv::resize(faceExtracted, coarse, cv::Size(faceExtracted.cols / coarseScale, faceExtracted.rows / coarseScale), 0, 0, cv::INTER_AREA);
+
+		std::vector<RegionInfo>& coarseSkin = m_Workspace->coarseSkinRegions[imgNr];
+		std::vector<RegionInfo>& coarseHoles = m_Workspace->coarseHoles[imgNr];
+		m_Workspace->labellers[imgNr].labelRegions(coarse, m_Workspace->coarseLabels[imgNr], coarseSkin, coarseHoles);
+		if (coarseSkin.empty())
+		{
+			return imgRect;
+		}
+
+		// back to the detection image, with a margin for the pixels which got lost by the integer division of the size
+		const cv::Rect& box = std::min_element(coarseSkin.begin(), coarseSkin.end())->boundingBox;
+		const int margin = 2 * coarseScale;
+		const cv::Rect roi(box.x*coarseScale - margin, box.y*coarseScale - margin, box.width*coarseScale + 2 * margin, box.height*coarseScale + 2 * margin);
+		return roi & imgRect;
+	}
+
+
+
+	bool Detection::isFaceInsideRoi(size_t imgNr, const cv::Rect& roi, const std::vector<RegionInfo>& skinRegions) const
+	{
+		const cv::Mat& faceExtracted = m_FaceExtracted[imgNr];
+		if (roi.width == faceExtracted.cols && roi.height == faceExtracted.rows)
+		{
+			return true;
+		}
+		if (skinRegions.empty())
+		{
+			return false;
+		}
+
+		// a region which touches a border of the roi that is not a border of the image may continue outside of it
+		const bool openLeft = roi.x > 0;
+		const bool openTop = roi.y > 0;
+		const bool openRight = roi.x + roi.width < faceExtracted.cols;
+		const bool openBottom = roi.y + roi.height < faceExtracted.rows;
+		int face = 0;
+		int biggestCut = 0;
+		for (size_t i = 0; i < skinRegions.size(); ++i)
+		{
+			const cv::Rect& box = skinRegions[i].boundingBox;
+			const bool isCut = (openLeft && box.x == 0) || (openTop && box.y == 0)
+				|| (openRight && box.x + box.width == roi.width) || (openBottom && box.y + box.height == roi.height);
+			int& biggest = isCut ? biggestCut : face;
+			biggest = std::max(biggest, skinRegions[i].area);
+		}
+
+		// any region outside has at most all skin pixels outside of the roi, a cut region additionally its part inside
+		const int outside = cv::countNonZero(faceExtracted) - cv::countNonZero(faceExtracted(roi));
+		return face > 0 && face >= biggestCut + outside;
+	}
+
+
+
+	void Detection::toGeometryCoordinates(size_t imgNr)
+	{
+		if (m_DetectionSize == imgSize)
+		{
+			return;
+		}
+
+		const double s = double(imgSize) / m_DetectionSize;
+		const cv::Mat scaleMat = getScaleTransform(s, s);
+		if (frontImgNr == imgNr)
+		{
+			m_FaceGeometry.transform(FaceGeometry::FrontLeftEye, scaleMat);
+			m_FaceGeometry.transform(FaceGeometry::FrontRightEye, scaleMat);
+			m_FaceGeometry.transform(FaceGeometry::FrontMouth, scaleMat);
+			m_FaceGeometry.transform(FaceGeometry::FrontLeftCheek, scaleMat);
+			m_FaceGeometry.transform(FaceGeometry::FrontRightCheek, scaleMat);
+		}
+		else if (sideImgNr == imgNr)
+		{
+			m_FaceGeometry.transform(FaceGeometry::SideEye, scaleMat);
+			m_FaceGeometry.transform(FaceGeometry::SideNoseTip, scaleMat);
+			m_FaceGeometry.transform(FaceGeometry::SideChin, scaleMat);
+			m_FaceGeometry.transform(FaceGeometry::SideBack, scaleMat);
+		}
+	}
+
+
+
+	void Detection::refineFaceBorders(size_t imgNr)
+	{
+		ScopedStageTimer timer("refineFaceBorders", static_cast<int>(imgNr));
+
+		// the cheeks and the back of the head are the first/last skin pixel in a row, which is only as accurate as a pixel of the detection image
+		// the other landmarks (eyes, mouth, nose, chin) are not refined and keep the accuracy of the detection image
+		if (frontImgNr == imgNr)
+		{
+			m_FaceGeometry.setDetectedPoint(FaceGeometry::FrontLeftCheek, refineRowExtent(imgNr, m_FaceGeometry.getDetectedPoint(FaceGeometry::FrontLeftCheek), true));
+			m_FaceGeometry.setDetectedPoint(FaceGeometry::FrontRightCheek, refineRowExtent(imgNr, m_FaceGeometry.getDetectedPoint(FaceGeometry::FrontRightCheek), false));
+		}
+		else if (sideImgNr == imgNr)
+		{
+			m_FaceGeometry.setDetectedPoint(FaceGeometry::SideBack, refineRowExtent(imgNr, m_FaceGeometry.getDetectedPoint(FaceGeometry::SideBack), true));
+		}
+	}
+
+
+
+	cv::Point2d Detection::refineRowExtent(size_t imgNr, const cv::Point2d& pt, bool fromLeft)
+	{
+		// full resolution pixels per detection pixel, nothing to gain if the detection image is not smaller
+		const cv::Mat& fullRes = m_FullRes[imgNr];
+		const double s = double(fullRes.cols) / m_DetectionSize;
+		if (s <= 1.0)
+		{
+			return pt;
+		}
+
+		// position in the full resolution image
+		const cv::Mat geometryToFullRes = getFullResToGeometryTransform(imgNr).inv();
+		const double xFull = geometryToFullRes.at<double>(0, 0)*pt.x + geometryToFullRes.at<double>(0, 2);
+		const double yFull = geometryToFullRes.at<double>(1, 1)*pt.y + geometryToFullRes.at<double>(1, 2);
+		const int y = cvRound(yFull);
+		if (y < 0 || y >= fullRes.rows)
+		{
+			return pt;
+		}
+
+		// the estimate is off by at most about one detection pixel plus the erosion
+		const int searchRadius = cvCeil(4 * s);
+
+		// same steps as for the detection image, with the kernels scaled to full resolution (the 5x5 gaussian has sigma 1.1).
+		// the element covers anchor pixels above/left of a pixel and elementSize-1-anchor below/right, the blur its radius on all sides.
+		// the strip includes all of them, so inside the search window the result is the same as for the whole image
+		// (the erosion treats pixels outside the strip as skin, which is only right at the image border)
+		const int anchor = cvRound(s);
+		const int elementSize = cvRound(5 * s);
+		const int blurRadius = cvCeil(3 * 1.1 * s);
+		const int before = anchor + blurRadius;
+		const int after = elementSize - anchor + blurRadius;
+		cv::Rect strip(cvRound(xFull) - searchRadius - before, y - before, 2 * searchRadius + before + after + 1, before + after + 1);
+		strip &= cv::Rect(0, 0, fullRes.cols, fullRes.rows);
+		if (strip.area() == 0)
+		{
+			return pt;
+		}
+
+		cv::Mat& blurred = m_Workspace->stripBlurred[imgNr];
+		cv::Mat& skin = m_Workspace->stripSkin[imgNr];
+		BinaryMask& eroded = m_Workspace->stripEroded[imgNr];
+		cv::GaussianBlur(fullRes(strip), blurred, cv::Size(0, 0), 1.1*s, 1.1*s);
+		segmentSkin(blurred, skin, getSkinThresholds(m_OffsetCR, m_OffsetCB));
+
+		// the element grows with the resolution, the bit-packed erosion costs log2 of its width and is independent of its height
+		eroded.fromMat(skin);
+		eroded.erode(eroded, cv::Size(elementSize, elementSize), cv::Point(anchor, anchor));
+
+		// search the first skin pixel inside the window, coming from outside the face
+		const int yStrip = y - strip.y;
+		const int xBegin = std::max(cvRound(xFull) - searchRadius, strip.x) - strip.x;
+		const int xEnd = std::min(cvRound(xFull) + searchRadius, strip.x + strip.width - 1) - strip.x;
+		if (xBegin > xEnd || eroded.at(yStrip, fromLeft ? xBegin : xEnd))
+		{
+			// the face border is outside of the window, keep the estimate
+			return pt;
+		}
+		const int x = fromLeft ? eroded.leftmost(yStrip, xBegin, xEnd + 1) : eroded.rightmost(yStrip, xBegin, xEnd + 1);
+		if (x >= 0)
+		{
+			const cv::Mat toGeometry = getFullResToGeometryTransform(imgNr);
+			return cv::Point2d(toGeometry.at<double>(0, 0)*(x + strip.x) + toGeometry.at<double>(0, 2), pt.y);
+		}
+
+		return pt;
+	}
+
+
+	void Detection::doFacialComponentsExtractionFront(FaceGeometry& faceGeometry, const cv::Mat& labels, const std::vector<RegionInfo>& componentInfo, const std::vector<RegionInfo>& faceInfo)
 	{
 		// we need at least 3 elements (left & right eye, mouth)
-		if (componentContourInfo.size()<3 || faceContourInfo.size()<1)
+		if (componentInfo.size()<3 || faceInfo.size()<1)
 		{
 			throw std::exception("we need at least 3 regions for classification as left & right eye, mouth (front image)");
 		}
 		
-		std::vector<ContourInfo> biggestThree(componentContourInfo.begin(), componentContourInfo.begin() + 3);
-
-		ContourInfo mouth;
-		std::vector<ContourInfo> eyes;
-		for (size_t i = 0; i < biggestThree.size(); ++i)
+		// the biggest three regions (sorted by area) are classified by their position
+		RegionInfo mouth;
+		RegionInfo eyes[2];
+		size_t numEyes = 0;
+		for (size_t i = 0; i < 3; ++i)
 		{
-			if (biggestThree[i].cogY > faceContourInfo[0].cogY)
+			if (componentInfo[i].cogY > faceInfo[0].cogY)
+			{
+				mouth = componentInfo[i];
+			}
+			else if (numEyes < 2)
 			{
-				mouth = biggestThree[i];
+				eyes[numEyes++] = componentInfo[i];
 			}
 			else
 			{
-				eyes.push_back(biggestThree[i]);
+				++numEyes;
 			}
 		}
 
 		// we need at least 3 elements (left & right eye, mouth)
-		if (eyes.size()!=2)
+		if (numEyes!=2)
 		{
 			throw std::exception("couldn't identify both eyes");
 		}
 
 
 		// left / right eye
-		ContourInfo leftEye = eyes[0].cogX < eyes[1].cogX ? eyes[0] : eyes[1];
-		ContourInfo rightEye = eyes[0].cogX > eyes[1].cogX ? eyes[0] : eyes[1];
+		RegionInfo leftEye = eyes[0].cogX < eyes[1].cogX ? eyes[0] : eyes[1];
+		RegionInfo rightEye = eyes[0].cogX > eyes[1].cogX ? eyes[0] : eyes[1];
 
 		faceGeometry.setDetectedPoint(FaceGeometry::FrontLeftEye, cv::Point2d(leftEye.cogX, leftEye.cogY));
 		faceGeometry.setDetectedPoint(FaceGeometry::FrontRightEye, cv::Point2d(rightEye.cogX, rightEye.cogY));
@@ -213,44 +628,36 @@ namespace Face3D
 		const cv::Point eyePos = faceGeometry.getDetectedPoint(FaceGeometry::FrontLeftEye);
 		cv::Point leftCheek, rightCheek;
 
-		// left
-		for (int x = 0; x<m_FaceExtracted[sideImgNr].cols; ++x)
+		// leftmost and rightmost skin pixel in the row of the eyes, only this row gets encoded
+		const cv::Rect& roi = m_FaceRoi[frontImgNr];
+		RunLengthMask& skinRuns = m_Workspace->skinRuns[frontImgNr];
+		skinRuns.encodeRows(m_FaceExtracted[frontImgNr], eyePos.y, eyePos.y + 1);
+		if (eyePos.y >= 0 && eyePos.y < skinRuns.rows())
 		{
-			if (m_FaceExtracted[frontImgNr].at<unsigned char>(cv::Point(x, eyePos.y)) != 0)
+			const int left = skinRuns.leftmost(eyePos.y, roi.x, roi.x + roi.width);
+			const int right = skinRuns.rightmost(eyePos.y, roi.x, roi.x + roi.width);
+			if (left >= 0)
 			{
-				leftCheek.x = x;
-				leftCheek.y = eyePos.y;
-				break;
-			}
-		}
-
-		// right 
-		for (int x = m_FaceExtracted[sideImgNr].cols-1; x>=0; --x)
-		{
-			if (m_FaceExtracted[frontImgNr].at<unsigned char>(cv::Point(x, eyePos.y)) != 0)
-			{
-				rightCheek.x = x;
-				rightCheek.y = eyePos.y;
-				break;
+				leftCheek = cv::Point(left, eyePos.y);
+				rightCheek = cv::Point(right, eyePos.y);
 			}
 		}
 
 		faceGeometry.setDetectedPoint(FaceGeometry::FrontLeftCheek, leftCheek);
 		faceGeometry.setDetectedPoint(FaceGeometry::FrontRightCheek, rightCheek);
-		
-
-		// create face mask
-		cv::Mat mask(imgSize,imgSize,CV_8U);
-		mask.setTo(0);
-		cv::drawContours(mask, std::vector<std::vector<cv::Point> > {faceContourInfo[0].contour}, 0, 255, -1);
-		m_FaceMask.push_back(mask);		
 
 		
 		// show debug info
+		if (m_Headless)
+		{
+			return;
+		}
+
 		cv::Mat tmp=getCopyOfOriginal(frontImgNr);
-		cv::drawContours(tmp, std::vector<std::vector<cv::Point> > {leftEye.contour}, 0, cv::Scalar(255, 0, 0), -1);
-		cv::drawContours(tmp, std::vector<std::vector<cv::Point> > {rightEye.contour}, 0, cv::Scalar(0, 255, 0), -1);
-		cv::drawContours(tmp, std::vector<std::vector<cv::Point> > {mouth.contour}, 0, cv::Scalar(0, 0, 255), -1);			
+		cv::Mat tmpRoi = tmp(roi);
+		tmpRoi.setTo(cv::Scalar(255, 0, 0), labels == leftEye.label);
+		tmpRoi.setTo(cv::Scalar(0, 255, 0), labels == rightEye.label);
+		tmpRoi.setTo(cv::Scalar(0, 0, 255), labels == mouth.label);
 		dbgShow(tmp, "doFacialComponentsExtractionFront");
 	}
 
@@ -271,28 +678,50 @@ namespace Face3D
 	}
 
 
-	void Detection::doFacialComponentsExtractionSide(FaceGeometry& faceGeometry, const std::vector<ContourInfo>& componentContourInfo, const std::vector<ContourInfo>& faceContourInfo)
+	void Detection::doFacialComponentsExtractionSide(FaceGeometry& faceGeometry, const cv::Mat& labels, const std::vector<RegionInfo>& componentInfo, const std::vector<RegionInfo>& faceInfo)
 	{
 		// we need at least 3 elements (left & right eye, mouth)
-		if (componentContourInfo.size()<1 || faceContourInfo.size()<1)
+		if (componentInfo.size()<1 || faceInfo.size()<1)
 		{
 			throw std::exception("we need at least 1 region for classification as eye (side image)");
 		}
 
-		const ContourInfo& eye = componentContourInfo[0];
-		const ContourInfo& face = faceContourInfo[0];
+		const RegionInfo& eye = componentInfo[0];
 		
 		faceGeometry.setDetectedPoint(FaceGeometry::SideEye, cv::Point2d(eye.cogX, eye.cogY));
+
+		// the outline of the face is only needed for the side image: trace the contour of the face mask (copy as findContours changes the image)
+		const cv::Rect& roi = m_FaceRoi[sideImgNr];
+		std::vector<std::vector<cv::Point> >& faceContours = m_Workspace->faceContours[sideImgNr];
+		cv::Mat& tmpMask = m_Workspace->faceContourTmp[sideImgNr];
+		m_FaceMask[sideImgNr](roi).copyTo(tmpMask);
+		cv::findContours(tmpMask, faceContours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE, roi.tl());
+		if (faceContours.empty())
+		{
+			throw std::exception("couldn't find the outline of the face (side image)");
+		}
+		const std::vector<cv::Point>& faceContour = faceContours[0];
 		
 						
-		// find bounding polygon with at least 5 vertices
-		std::vector<cv::Point> polygonPoints;
+		// find bounding polygon with at least 5 vertices: the importance of the vertices is computed once, each tolerance is then only a linear scan
+		PolygonSimplifier& simplifier = m_Workspace->profileSimplifier;
+		std::vector<cv::Point>& polygonPoints = m_Workspace->profilePolygon;
+		simplifier.setContour(faceContour);
 		double precission = 50.0;
-		while (polygonPoints.size() < 5)
-		{				
-			cv::approxPolyDP(face.contour, polygonPoints, precission, true);
+		while (simplifier.countVertices(precission) < 5 && precission > 1.0)
+		{
 			precission = precission / 2;
 		}
+		simplifier.simplify(precission, polygonPoints);
+		if (polygonPoints.size() < 5)
+		{
+			// nearly straight outline, no tolerance gives enough vertices: take the most important ones
+			simplifier.simplifyToCount(5, polygonPoints);
+		}
+		if (polygonPoints.size() < 5)
+		{
+			throw std::exception("the outline of the face is too small (side image)");
+		}
 			
 		
 
@@ -344,33 +773,32 @@ namespace Face3D
 		// find back side of head
 		const cv::Point chinPoint = faceGeometry.getDetectedPoint(FaceGeometry::SideChin);
 		cv::Point backPoint;
-		for (int x = 0; x<m_FaceExtracted[sideImgNr].cols; ++x)
-		{			
-			if (m_FaceExtracted[sideImgNr].at<unsigned char>(cv::Point(x, chinPoint.y))!=0)
+		RunLengthMask& skinRuns = m_Workspace->skinRuns[sideImgNr];
+		skinRuns.encodeRows(m_FaceExtracted[sideImgNr], chinPoint.y, chinPoint.y + 1);
+		if (chinPoint.y >= 0 && chinPoint.y < skinRuns.rows())
+		{
+			const int back = skinRuns.leftmost(chinPoint.y, roi.x, roi.x + roi.width);
+			if (back >= 0)
 			{
-				backPoint.x = x;
-				backPoint.y = chinPoint.y;
-				break;
+				backPoint = cv::Point(back, chinPoint.y);
 			}
 		}
 		faceGeometry.setDetectedPoint(FaceGeometry::SideBack, backPoint);
-
-
-		// create face mask
-		cv::Mat mask(imgSize, imgSize, CV_8U);
-		mask.setTo(0);
-		cv::drawContours(mask, std::vector<std::vector<cv::Point> > {face.contour}, 0, 255, -1);
-		m_FaceMask.push_back(mask);
 		
 
 		// show debug info
+		if (m_Headless)
+		{
+			return;
+		}
+
 		cv::Mat tmp = getCopyOfOriginal(sideImgNr);
-		cv::drawContours(tmp, std::vector<std::vector<cv::Point> > {eye.contour}, 0, cv::Scalar(255, 0, 0), -1);
+		tmp(roi).setTo(cv::Scalar(255, 0, 0), labels == eye.label);
 		dbgShow(tmp, "doFacialComponentsExtractionSide");
 
 		// and the polygon
-		cv::Mat tmpChin = cv::Mat::zeros(imgSize, imgSize, CV_8UC3);
-		cv::drawContours(tmpChin, std::vector<std::vector<cv::Point> > {face.contour}, 0, cv::Scalar(100, 100, 100), -1);
+		cv::Mat tmpChin = cv::Mat::zeros(m_FaceExtracted[sideImgNr].size(), CV_8UC3);
+		cv::drawContours(tmpChin, faceContours, 0, cv::Scalar(100, 100, 100), -1);
 		cv::RNG rng(0);
 		for (size_t i = 0; i < numPolygonPoints; ++i)
 		{
@@ -383,98 +811,45 @@ namespace Face3D
 
 
 
-
-	std::vector<size_t> Detection::findRegions(const std::vector<std::vector<cv::Point> >& contours, const std::vector<cv::Vec4i>& hierarchy, RegionType regionType)
+	void Detection::doMatchCoordinates()
 	{
-		/*
-		from http://docs.opencv.org/2.4/modules/imgproc/doc/structural_analysis_and_shape_descriptors.html?highlight=findcontours#findcontours:
-		hierarchy  Optional output vector, containing information about the image topology. It has as many elements as the number of contours.
-		For each i-th contour contours[i] , the elements hierarchy[i][0] , hiearchy[i][1] , hiearchy[i][2] , and hiearchy[i][3]
-		are set to 0-based indices in contours of the next and previous contours at the same hierarchical level, the first child contour and the parent contour,
-		respectively. If for the contour i there are no next, previous, parent, or nested contours, the corresponding elements of hierarchy[i] will be negative.
-		*/
-		const int NEXT_CONTOUR = 0, PREV_CONTOUR = 1, CHILD_CONTOUR = 2, PARENT_CONTOUR = 3;				
-
-		std::vector<size_t> res;
+		ScopedStageTimer timer("matchCoordinates");
 
-		assert(contours.size() == hierarchy.size()); // should be the same according to opencv doc!
-		for (size_t i = 0; i < contours.size(); ++i)
-		{
-			// take just those contours which are nestet, i.e. which have a parent contour!
-			if ((regionType == RegionTypeInside && hierarchy[i][PARENT_CONTOUR]>= 0) || (regionType == RegionTypeOutside && hierarchy[i][PARENT_CONTOUR] < 0))
-			{				
-				res.push_back(i);
-			}
-		}
-
-		return res;
+		m_FaceGeometry.merge3d();
 	}
 
+	
 
-
-	std::vector<Detection::ContourInfo> Detection::extractContourInfo(const std::vector<std::vector<cv::Point> >& contours, const std::vector<size_t> indices)
+	void Detection::createTextures()
 	{
-		std::vector<ContourInfo> contourInfos;
+		ScopedStageTimer timer("createTextures");
 
-		for (size_t i = 0; i < indices.size(); ++i)
-		{
-			ContourInfo contourInfo;
-			contourInfo.contour = contours[indices[i]];
-			contourInfo.areaOfContour = cv::contourArea(contours[indices[i]]);
-
-			cv::Moments moments = cv::moments(contours[indices[i]]);
-			contourInfo.cogX = moments.m10 / moments.m00;
-			contourInfo.cogY = moments.m01 / moments.m00;
-
-			contourInfos.push_back(contourInfo);
-		}
-
-		// sort by area
-		std::sort(contourInfos.begin(), contourInfos.end());
-
-		return contourInfos;
+		alignImages();
+		cropTextures();
 	}
 
 
 
-	void Detection::doMatchCoordinates()
-	{
-		m_FaceGeometry.merge3d();
-	}
-
-	
-
-	void Detection::createTextures()
+	void Detection::alignImages()
 	{						
-		// allocate images		
-		m_Textures.resize(2);
-		
-		// zero-out images
-		m_Textures[frontImgNr] = cv::Mat::zeros(imgSize,imgSize,CV_8UC3);
-		m_Textures[sideImgNr] = cv::Mat::zeros(imgSize, imgSize, CV_8UC3);
-
-		// mask images
-		m_Originals[frontImgNr].copyTo(m_Textures[frontImgNr]);
-		m_Originals[sideImgNr].copyTo(m_Textures[sideImgNr]);		
-
-		//dbgShow(m_Textures[frontImgNr], "TestImage");
+		// only the transformations are stored, the images get warped when the textures are extracted
+		m_AlignTransform.resize(2);
+		m_FaceGeometryDetected = m_FaceGeometry;
 
 		// front image: rotate so that eyes are on a horizontal line
 		cv::Vec2d vecEyes(m_FaceGeometry.getDetectedPoint(FaceGeometry::FrontRightEye) - m_FaceGeometry.getDetectedPoint(FaceGeometry::FrontLeftEye));
 		const double alpha=atan(vecEyes[1] / vecEyes[0])*180.0/M_PI;
-		cv::Point centerPoint(m_Textures[frontImgNr].cols / 2, m_Textures[frontImgNr].rows / 2);
+		cv::Point centerPoint(imgSize / 2, imgSize / 2);
 
-		// transform front image
+		// transformation of front image
 		cv::Mat rotMat = cv::getRotationMatrix2D(centerPoint, alpha, 1.0);
-		cv::warpAffine(m_Textures[frontImgNr], m_Textures[frontImgNr], rotMat, m_Textures[frontImgNr].size());
+		m_AlignTransform[frontImgNr] = rotMat;
 		
 
 		// transform all front coordinates
 		m_FaceGeometry.transform(FaceGeometry::FrontLeftEye, rotMat);
 		m_FaceGeometry.transform(FaceGeometry::FrontRightEye, rotMat);
 		m_FaceGeometry.transform(FaceGeometry::FrontMouth, rotMat);
-		
-		//dbgShow(m_Textures[frontImgNr], "createTextures: frontImage rotated");
 
 
 
@@ -483,17 +858,26 @@ namespace Face3D
 		transMat.at<double>(0, 0) = transMat.at<double>(1, 1) = 1.0;
 		transMat.at<double>(1, 2) = m_FaceGeometry.getDetectedPoint(FaceGeometry::FrontLeftEye).y - m_FaceGeometry.getDetectedPoint(FaceGeometry::SideEye).y;
 		
-		// transform side image
-		cv::warpAffine(m_Textures[sideImgNr], m_Textures[sideImgNr], transMat, m_Textures[frontImgNr].size());
+		// transformation of side image
+		m_AlignTransform[sideImgNr] = transMat;
 
 		// transform all side coordinates
 		m_FaceGeometry.transform(FaceGeometry::SideEye, transMat);
 		m_FaceGeometry.transform(FaceGeometry::SideNoseTip, transMat);
 		m_FaceGeometry.transform(FaceGeometry::SideChin, transMat);
 
-		//dbgShow(m_Textures[sideImgNr], "createTextures: sideImage translated");		
+		// the texture adjustment trackbars start from here
+		m_FaceGeometryAligned = m_FaceGeometry;
+	}
+
 
 
+	void Detection::cropTextures()
+	{
+		// the texture coordinates of a previous call get replaced
+		m_FaceGeometry = m_FaceGeometryAligned;
+		m_Textures.resize(2);
+
 		// cut out regions of interest, but do it in a way such that the y coordinate (position of eyes) still aligns between front and side image
 		cv::Rect frontBoundingBox, sideBoundingBox;
 
@@ -520,15 +904,10 @@ namespace Face3D
 		sideBoundingBox.height = sideBoundingBox.y + sideBoundingBox.height < imgSize ? sideBoundingBox.height : imgSize - sideBoundingBox.y;
 		
 
-		m_Textures[frontImgNr](frontBoundingBox).copyTo(m_Textures[frontImgNr]);
-		m_Textures[sideImgNr](sideBoundingBox).copyTo(m_Textures[sideImgNr]);
-	
-		// and now cut out the regions according to bounding box
-
-		// resize to OpenGL compatible texture size (2^n x 2^n)
-		const size_t texSize = 256;
-		cv::resize(m_Textures[sideImgNr], m_Textures[sideImgNr], cv::Size(texSize, texSize));
-		cv::resize(m_Textures[frontImgNr], m_Textures[frontImgNr], cv::Size(texSize, texSize));
+		// and now cut out the regions according to bounding box and resize to OpenGL compatible texture size (2^n x 2^n)
+		const int texSize = 256;
+		extractTexture(sideImgNr, sideBoundingBox, texSize);
+		extractTexture(frontImgNr, frontBoundingBox, texSize);
 
 		// calc the position of the eyes in the texture [0..1]
 		// left eye
@@ -555,6 +934,70 @@ namespace Face3D
 
 
 
+	void Detection::extractTexture(size_t imgNr, const cv::Rect& boundingBox, int texSize)
+	{
+		// mapping of the aligned image to the texture: crop and scale, with the same pixel-center convention as cv::resize
+		const double sx = double(boundingBox.width) / texSize;
+		const double sy = double(boundingBox.height) / texSize;
+		cv::Mat cropMat = cv::Mat::zeros(3, 3, CV_64F);
+		cropMat.at<double>(0, 0) = 1.0 / sx;
+		cropMat.at<double>(0, 2) = -(boundingBox.x - 0.5 + 0.5*sx) / sx;
+		cropMat.at<double>(1, 1) = 1.0 / sy;
+		cropMat.at<double>(1, 2) = -(boundingBox.y - 0.5 + 0.5*sy) / sy;
+		cropMat.at<double>(2, 2) = 1.0;
+
+		// full resolution -> geometry coordinates -> aligned -> texture. warpAffine maps each texture pixel back into the full resolution image
+		cv::Mat alignMat = cv::Mat::eye(3, 3, CV_64F);
+		m_AlignTransform[imgNr].copyTo(alignMat.rowRange(0, 2));
+		cv::Mat texMat = cv::Mat(cropMat * alignMat * getFullResToGeometryTransform(imgNr));
+
+		// a camera photo has several full resolution pixels per texture pixel, bilinear sampling alone would alias (moire in skin and hair).
+		// so the region of the texture is first averaged down with INTER_AREA until at most 2 pixels fall onto a texture pixel
+		const double det = texMat.at<double>(0, 0)*texMat.at<double>(1, 1) - texMat.at<double>(0, 1)*texMat.at<double>(1, 0);
+		const double reduce = 1.0 / std::sqrt(std::abs(det)) / 2.0;
+		if (reduce > 1.0)
+		{
+			// bounding box of the texture corners in the full resolution image, with a margin for the bilinear interpolation
+			cv::Mat texToFullRes;
+			cv::invertAffineTransform(texMat.rowRange(0, 2), texToFullRes);
+			double minX = DBL_MAX, minY = DBL_MAX, maxX = -DBL_MAX, maxY = -DBL_MAX;
+			for (int corner = 0; corner < 4; ++corner)
+			{
+				const double u = (corner & 1) ? texSize : 0.0;
+				const double v = (corner & 2) ? texSize : 0.0;
+				const double x = texToFullRes.at<double>(0, 0)*u + texToFullRes.at<double>(0, 1)*v + texToFullRes.at<double>(0, 2);
+				const double y = texToFullRes.at<double>(1, 0)*u + texToFullRes.at<double>(1, 1)*v + texToFullRes.at<double>(1, 2);
+				minX = std::min(minX, x);
+				minY = std::min(minY, y);
+				maxX = std::max(maxX, x);
+				maxY = std::max(maxY, y);
+			}
+			const int margin = cvCeil(2 * reduce);
+			cv::Rect region(cvFloor(minX) - margin, cvFloor(minY) - margin, cvCeil(maxX - minX) + 2 * margin + 1, cvCeil(maxY - minY) + 2 * margin + 1);
+			region &= cv::Rect(0, 0, m_FullRes[imgNr].cols, m_FullRes[imgNr].rows);
+			if (region.area() > 0)
+			{
+				cv::Mat& prefiltered = m_Workspace->texturePrefiltered[imgNr];
+				cv::resize(m_FullRes[imgNr](region), prefiltered, cv::Size(std::max(1, cvRound(region.width / reduce)), std::max(1, cvRound(region.height / reduce))), 0, 0, cv::INTER_AREA);
+
+				// prefiltered -> full resolution, with the pixel-center convention of cv::resize
+				const double rx = double(region.width) / prefiltered.cols;
+				const double ry = double(region.height) / prefiltered.rows;
+				cv::Mat toFullRes = cv::Mat::eye(3, 3, CV_64F);
+				toFullRes.at<double>(0, 0) = rx;
+				toFullRes.at<double>(0, 2) = region.x + 0.5*rx - 0.5;
+				toFullRes.at<double>(1, 1) = ry;
+				toFullRes.at<double>(1, 2) = region.y + 0.5*ry - 0.5;
+				cv::warpAffine(prefiltered, m_Textures[imgNr], cv::Mat(texMat * toFullRes).rowRange(0, 2), cv::Size(texSize, texSize), cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar());
+				return;
+			}
+		}
+
+		cv::warpAffine(m_FullRes[imgNr], m_Textures[imgNr], texMat.rowRange(0, 2), cv::Size(texSize, texSize), cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar());
+	}
+
+
+
 	cv::Rect Detection::getBoundingBox(const cv::Mat& color)
 	{
 		cv::Mat gray, bin;
@@ -584,11 +1027,18 @@ namespace Face3D
 	}
 
 
+	void Detection::setColorThreshold(int val)
+	{
+		// the trackbar value is in [0..20], 10 means that the default thresholds are used
+		m_OffsetCR = val - 10;
+		m_OffsetCB = val - 10;
+	}
+
+
 	void onColorThresholdsTrackbar(int val, void* ptr)
 	{
 		Detection* detection = static_cast<Detection*>(ptr);
-		detection->m_OffsetCR = val - 10;
-		detection->m_OffsetCB = val - 10;
+		detection->setColorThreshold(val);
 		detection->doFaceExtraction();
 
 		cv::imshow("Select color threshold", detection->combineVertically(detection->m_FaceExtracted[detection->frontImgNr], detection->m_FaceExtracted[detection->sideImgNr]));
@@ -615,8 +1065,7 @@ namespace Face3D
 	{
 		Detection* detection = static_cast<Detection*>(ptr);
 		detection->m_AddTextureBottom = val/100.0;
-		detection->m_FaceGeometry = detection->m_FaceGeometryBackup;
-		detection->createTextures();
+		detection->cropTextures();
 
 		cv::imshow("Resulting textures", detection->combineVertically(detection->m_Textures[detection->frontImgNr], detection->m_Textures[detection->sideImgNr]));
 	}
@@ -625,8 +1074,7 @@ namespace Face3D
 	{
 		Detection* detection = static_cast<Detection*>(ptr);
 		detection->m_AddTextureTop = val / 100.0;
-		detection->m_FaceGeometry = detection->m_FaceGeometryBackup;
-		detection->createTextures();
+		detection->cropTextures();
 
 		cv::imshow("Resulting textures", detection->combineVertically(detection->m_Textures[detection->frontImgNr], detection->m_Textures[detection->sideImgNr]));
 	}
@@ -645,7 +1093,6 @@ namespace Face3D
 
 		// 2. textures
 		// show gui
-		m_FaceGeometryBackup = m_FaceGeometry;
 		static int topValue = 70;
 		static int bottomValue = 50;
 		m_AddTextureTop = topValue/100.0;
@@ -3,7 +3,12 @@
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <vector>
+#include <functional>
+#include <memory>
 #include "FaceGeometry.hpp"
+#include "FaceData.hpp"
+#include "RegionLabelling.hpp"
+#include "DetectionWorkspace.hpp"
 
 /*
 This class implements the first part of the pileline: detection of the individual face components
@@ -28,15 +33,45 @@ namespace Face3D
 		/** \brief  create a Detection object
 		* \param front image of the face from the front
 		* \param side image of the face from the side
+		* \param workspace buffers of the pipeline, pass the same workspace to process many image pairs without allocations
 		*/
-		Detection(const cv::Mat& front, const cv::Mat& side);
+		Detection(const cv::Mat& front, const cv::Mat& side, std::shared_ptr<DetectionWorkspace> workspace = std::make_shared<DetectionWorkspace>());
 
-		/** class which holds the result: information about the face geometry and the front and side textures */
+		/** class which holds the result: information about the face geometry and the front and side textures.
+		* the textures share their memory with the DetectionWorkspace and are overwritten by the next detection which uses the same workspace,
+		* clone them if they are needed longer (e.g. when the workspace is reused for the next image pair)
+		*/
 		struct DetectFaceResult
 		{
 			FaceGeometry faceGeometry;
+			FaceGeometry detectedGeometry; ///< the points as detected in the input images (before the images got aligned), e.g. to track them in a video
 			cv::Mat textureFront;
 			cv::Mat textureSide;
+
+			/** the result for the viewer in the same process, the textures are not copied (they must outlive the returned data) */
+			FaceData toFaceData() const;
+		};
+
+		/** how the image gets smoothed before the skin segmentation, which only looks at the chroma channels.
+		* the chroma modes are faster (about 1.8x for the whole step with PreprocessChromaHalf, see --benchmark) but the masks differ
+		* slightly from PreprocessBgr, so they have to be chosen explicitly */
+		enum Preprocessing
+		{
+			PreprocessBgr, ///< blur all three channels of the BGR image, then convert
+			PreprocessChroma, ///< convert to the Cr and Cb planes first and only blur those
+			PreprocessChromaHalf ///< same, but the chroma planes and the thresholding at half the resolution
+		};
+
+		/** parameters which are otherwise selected interactively in the gui */
+		struct DetectFaceOptions
+		{
+			int colorThreshold = 10; ///< value of the color threshold trackbar [0..20], 10 means no offset
+			double addTextureTop = 0.7; ///< additional texture above the eyes, relative to the eye-chin distance
+			double addTextureBottom = 0.5; ///< additional texture below the chin, relative to the eye-chin distance
+			bool concurrent = true; ///< process front and side image in two threads
+			bool useLookupTable = true; ///< classify skin with the cached color lookup table (pays off when the thresholds don't change between runs). only used with PreprocessBgr
+			Preprocessing preprocessing = PreprocessBgr; ///< smoothing before the skin segmentation
+			size_t detectionSize = 320; ///< width and height of the scaled down image the facial components are detected in, the textures always come from the full resolution
 		};
 
 		/** \brief  calculate the face geometry and the textures
@@ -44,21 +79,22 @@ namespace Face3D
 		*/
 		DetectFaceResult detectFace();
 
-	private:
-		/** functor such that STL can be used to sort contours according to area */
-		struct ContourInfo
-		{
-			ContourInfo() : areaOfContour(0.0), cogX(0.0), cogY(0.0){}
-			std::vector<cv::Point> contour;
-			double areaOfContour;
-			double cogX, cogY;
-
-			bool operator<(const ContourInfo& other)
-			{
-				return areaOfContour>other.areaOfContour;
-			}
-		};
+		/** \brief  calculate the face geometry and the textures without any gui interaction (no windows, no waitKey)
+		* \param options the values which are otherwise selected in the gui
+		* \return a DetectFaceResult object which holds the face geometry and the textures
+		*/
+		DetectFaceResult detectFaceHeadless(const DetectFaceOptions& options);
 
+		/** \brief  skip the detection and create the result from known points, e.g. points tracked from a previous video frame. no gui interaction.
+		* \param detectedGeometry the points in the input images, same as DetectFaceResult::detectedGeometry
+		* \param options the texture adjustment is used, the other values are ignored
+		* \return a DetectFaceResult object which holds the face geometry and the textures
+		*/
+		DetectFaceResult createResultFromPoints(const FaceGeometry& detectedGeometry, const DetectFaceOptions& options);
+
+	private:
+		/** copy the result of the pipeline into a DetectFaceResult object */
+		DetectFaceResult getResult() const;
 
 		/** helper function to get original image to draw on for debug output */
 		cv::Mat getCopyOfOriginal(int imgNr)
@@ -68,44 +104,99 @@ namespace Face3D
 			return tmp;
 		}
 
+		/** scale down the full resolution images to the size in which the facial components get detected */
+		void createDetectionImages(size_t detectionSize);
+
+		/** affine transform (3x3) which scales an image, mapping pixel centers onto each other like cv::resize */
+		static cv::Mat getScaleTransform(double sx, double sy);
+
+		/** affine transform (3x3) from the full resolution image to the coordinate system of the face geometry */
+		cv::Mat getFullResToGeometryTransform(size_t imgNr) const;
+
+		/** find the region of interest around the face: bounding box of the biggest skin region, found in a coarse copy of the skin mask. checked with isFaceInsideRoi */
+		cv::Rect findFaceRoi(size_t imgNr);
+
+		/** \brief  check that the biggest skin region of the whole image is the one found inside of the region of interest.
+		* the coarse region is chosen by its coarse area, a sparse background region may win against the face.
+		* \param imgNr the image
+		* \param roi the region of interest from findFaceRoi
+		* \param skinRegions the foreground regions labelled inside of the roi, roi coordinates
+		*/
+		bool isFaceInsideRoi(size_t imgNr, const cv::Rect& roi, const std::vector<RegionInfo>& skinRegions) const;
+
+		/** transform the detected points of one image from the detection size to the coordinate system of the face geometry */
+		void toGeometryCoordinates(size_t imgNr);
+
+		/** improve the points at the left/right border of the face (cheeks, back of the head) using the full resolution image,
+		* only these border points are refined: eyes, mouth, nose and chin keep the accuracy of the detection image
+		*/
+		void refineFaceBorders(size_t imgNr);
+
+		/** \brief  search the first skin pixel in the row of the given point, in a small window around it in the full resolution image
+		* \param imgNr front or side image
+		* \param pt the estimated border point in geometry coordinates
+		* \param fromLeft search for the leftmost skin pixel (true) or the rightmost one (false)
+		* \return the refined point, or the estimate if the border isn't inside the window
+		*/
+		cv::Point2d refineRowExtent(size_t imgNr, const cv::Point2d& pt, bool fromLeft);
+
+		/** execute a pipeline stage for the front and the side image, the side image is processed in a second thread */
+		void runForBothImages(const std::function<void(size_t)>& stage);
+
 		/** preprocessing: smooth image */
 		void doPreprocessing();
+		void doPreprocessing(size_t imgNr);
+
+		/** the blurred BGR image, it is only created when a stage needs it */
+		const cv::Mat& getPreprocessed(size_t imgNr);
 		
 		/** extracts face (skin) region */
 		void doFaceExtraction();
+		void doFaceExtraction(size_t imgNr);
 
 		/** extract facial components (eyes, nose, ...) */
 		void doFacialComponentsExtraction();
+		void doFacialComponentsExtraction(size_t imgNr);
 
-		/** extract facial components in front image */
-		void doFacialComponentsExtractionFront(FaceGeometry& faceGeometry, const std::vector<ContourInfo>& componentContourInfo, const std::vector<ContourInfo>& faceContourInfo);
+		/** extract facial components in front image. the labels cover only the face region m_FaceRoi, the regions are in image coordinates */
+		void doFacialComponentsExtractionFront(FaceGeometry& faceGeometry, const cv::Mat& labels, const std::vector<RegionInfo>& componentInfo, const std::vector<RegionInfo>& faceInfo);
 
 		/** extract facial components in side image */
-		void doFacialComponentsExtractionSide(FaceGeometry& faceGeometry, const std::vector<ContourInfo>& componentContourInfo, const std::vector<ContourInfo>& faceContourInfo);
-
-		/** type of binary region to be looked for: an inner or an outer region */
-		enum RegionType{ RegionTypeInside, RegionTypeOutside };
+		void doFacialComponentsExtractionSide(FaceGeometry& faceGeometry, const cv::Mat& labels, const std::vector<RegionInfo>& componentInfo, const std::vector<RegionInfo>& faceInfo);
 
-		/** fget list of regions with specified type */
-		std::vector<size_t> findRegions(const std::vector<std::vector<cv::Point> >& contours, const std::vector<cv::Vec4i>& hierarchy, RegionType regionType);
-
-		/** calculate informations about the contours, e.g. the area */
-		std::vector<ContourInfo> extractContourInfo(const std::vector<std::vector<cv::Point> >& contours, const std::vector<size_t> indices);
-		
 		/** match the 2d coordinates of the facial components in the two images to get the 3d information */
 		void doMatchCoordinates();
 
 		/** create the textures from the two images and align them */
 		void createTextures();
 
+		/** calc the alignment of the two images (rotate front image, translate side image) and transform the facial points accordingly */
+		void alignImages();
+
+		/** cut out the textures from the aligned images, according to the texture adjustment (top/bottom) */
+		void cropTextures();
+
+		/** \brief  warp the original image into the texture: alignment, crop and resize in a single pass
+		* \param imgNr front or side image
+		* \param boundingBox region of the aligned image which becomes the texture
+		* \param texSize width and height of the texture
+		*/
+		void extractTexture(size_t imgNr, const cv::Rect& boundingBox, int texSize);
+
 		/** get the bounding box of the color image. background must be black, everything else will be regared as foreground. */
 		cv::Rect getBoundingBox(const cv::Mat& color);
 
 		/** gui interaction*/
+		bool m_Headless = false; ///< no gui and no debug output at all, e.g. for batch runs
+		bool m_Concurrent = true; ///< process front and side image in two threads
+		bool m_UseLookupTable = true; ///< classify skin with the cached color lookup table
+		Preprocessing m_Preprocessing = PreprocessBgr; ///< smoothing before the skin segmentation
+		bool m_PreprocessedValid[2]; ///< m_Preprocessed holds the blurred image of the current run
 		int m_ColorThresValue = 10;
 		int m_OffsetCB=0, m_OffsetCR=0;
 		double m_AddTextureBottom = 0;
 		double m_AddTextureTop = 0;
+		void setColorThreshold(int val);
 		void doFaceExtractionGUI();
 		void createTexturesAndShowResultsGUI();
 		cv::Mat combineVertically(const cv::Mat& a, const cv::Mat& b) const;
@@ -114,13 +205,21 @@ namespace Face3D
 		/** images (originals and processed) */
 		const size_t frontImgNr = 0; ///< index of the front image when both images are stored in an array
 		const size_t sideImgNr = 1; ///< index of the side image when both images are stored in an array
-		const size_t imgSize = 320; ///< size of the images we are working with. 320x320 seems good as its fast but has still enough details
-		std::vector<cv::Mat> m_Originals; ///< original images (scaled down)
-		std::vector<cv::Mat> m_Preprocessed; ///< preprocessed images (smooth)
-		std::vector<cv::Mat> m_FaceExtracted; ///< binary image with skin as foreground
-		std::vector<cv::Mat> m_FaceMask; ///< mask of the face regions. foreground regions which are not the face are already removed
-		FaceGeometry m_FaceGeometry, m_FaceGeometryBackup; ///< the geometry of the face, i.e. the coordinates of the facial components
-		std::vector<cv::Mat> m_Textures; ///< the textures, already in a format that can be used in OpenGL
+		const size_t imgSize = 320; ///< size of the coordinate system of the face geometry, and the default detection size. 320x320 seems good as its fast but has still enough details
+		size_t m_DetectionSize = 320; ///< size of the images the facial components are detected in
+		std::shared_ptr<DetectionWorkspace> m_Workspace; ///< owns all the buffers below, the members are just references into it
+		std::vector<cv::Mat>& m_FullRes; ///< the input images in full resolution, the textures are sampled from them
+		std::vector<cv::Mat>& m_Originals; ///< original images (scaled down to the detection size)
+		std::vector<cv::Mat>& m_Preprocessed; ///< preprocessed images (smooth)
+		std::vector<cv::Mat> &m_ChromaCr, &m_ChromaCb; ///< chroma planes of the preprocessed images, cached for the color threshold trackbar
+		std::vector<cv::Mat>& m_FaceExtracted; ///< binary image with skin as foreground
+		std::vector<cv::Mat>& m_FaceMask; ///< mask of the face regions. foreground regions which are not the face are already removed
+		cv::Rect m_FaceRoi[2]; ///< region around the face, the facial components are only searched inside of it
+		FaceGeometry m_FaceGeometry; ///< the geometry of the face, i.e. the coordinates of the facial components
+		FaceGeometry m_FaceGeometryDetected; ///< the geometry before aligning the images
+		FaceGeometry m_FaceGeometryAligned; ///< the geometry after aligning the images, the texture adjustment starts from here
+		std::vector<cv::Mat>& m_AlignTransform; ///< affine transformations which align the images (front rotated, side translated), cached for the texture adjustment
+		std::vector<cv::Mat>& m_Textures; ///< the textures, already in a format that can be used in OpenGL
 		
 		/** resulting images to show in the gui */
 		cv::Mat m_FacialPointsGUI;
@@ -0,0 +1,89 @@
+#include "DetectionWorkspace.hpp"
+
+
+namespace Face3D
+{
+
+
+	DetectionWorkspace::DetectionWorkspace()
+		: fullRes(2), originals(2), preprocessed(2), chromaCr(2), chromaCb(2), originalsHalf(2), skin(2), skinHalf(2), faceExtracted(2), coarse(2), coarseLabels(2), labels(2), faceMask(2), faceContourTmp(2)
+		, stripBlurred(2), stripSkin(2), alignTransform(2), texturePrefiltered(2), textures(2)
+		, stripEroded(2), skinRuns(2), skinRegions(2), componentRegions(2), coarseSkinRegions(2), coarseHoles(2), faceContours(2), labellers(2)
+	{
+		// REMARK: this is not in the original paper but helps to find the facial components, see Detection::doFaceExtraction
+		erodeElement = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(5, 5), cv::Point(1, 1));
+	}
+
+
+
+	void DetectionWorkspace::setAllocator(cv::MatAllocator* allocator)
+	{
+		std::vector<cv::Mat*> buffers = getImageBuffers();
+		for (size_t i = 0; i < buffers.size(); ++i)
+		{
+			buffers[i]->release();
+			buffers[i]->allocator = allocator;
+		}
+	}
+
+
+
+	int DetectionWorkspace::buffersNotUsingAllocator(const cv::MatAllocator* allocator)
+	{
+		// empty buffers are allocated with the allocator as soon as they are used
+		std::vector<cv::Mat*> buffers = getImageBuffers();
+		int res = 0;
+		for (size_t i = 0; i < buffers.size(); ++i)
+		{
+			if (!buffers[i]->empty() && buffers[i]->allocator != allocator)
+			{
+				++res;
+			}
+		}
+		return res;
+	}
+
+
+
+	size_t DetectionWorkspace::vectorCapacity() const
+	{
+		size_t res = 0;
+		for (size_t imgNr = 0; imgNr < 2; ++imgNr)
+		{
+			res += skinRegions[imgNr].capacity()*sizeof(RegionInfo);
+			res += componentRegions[imgNr].capacity()*sizeof(RegionInfo);
+			res += coarseSkinRegions[imgNr].capacity()*sizeof(RegionInfo);
+			res += coarseHoles[imgNr].capacity()*sizeof(RegionInfo);
+			res += labellers[imgNr].capacity();
+			res += skinRuns[imgNr].capacity();
+			res += stripEroded[imgNr].capacity();
+
+			res += faceContours[imgNr].capacity()*sizeof(std::vector<cv::Point>);
+			for (size_t i = 0; i < faceContours[imgNr].size(); ++i)
+			{
+				res += faceContours[imgNr][i].capacity()*sizeof(cv::Point);
+			}
+		}
+		res += profileSimplifier.capacity() + profilePolygon.capacity()*sizeof(cv::Point);
+		return res;
+	}
+
+
+
+	std::vector<cv::Mat*> DetectionWorkspace::getImageBuffers()
+	{
+		// the full resolution images and the transformations are not allocated by the pipeline, they are just assigned
+		std::vector<std::vector<cv::Mat>*> perImage = { &originals, &preprocessed, &chromaCr, &chromaCb, &originalsHalf, &skin, &skinHalf, &faceExtracted, &coarse, &coarseLabels, &labels, &faceMask, &faceContourTmp
+			, &stripBlurred, &stripSkin, &texturePrefiltered, &textures };
+
+		std::vector<cv::Mat*> res;
+		for (size_t i = 0; i < perImage.size(); ++i)
+		{
+			for (size_t imgNr = 0; imgNr < perImage[i]->size(); ++imgNr)
+			{
+				res.push_back(&(*perImage[i])[imgNr]);
+			}
+		}
+		return res;
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "RegionLabelling.hpp"
+#include "PolygonSimplification.hpp"
+#include "RunLengthMask.hpp"
+#include "BinaryMask.hpp"
+
+namespace Face3D
+{
+	/** all buffers of the detection pipeline. when a workspace is passed to several Detection objects one after the other,
+	* the buffers are reused: after the first image pair (of the same size) no further image buffers get allocated.
+	* a workspace must not be used by two Detection objects at the same time.
+	* the textures of a DetectFaceResult share their memory with the workspace, copy them if they are needed after the next run.
+	*/
+	class DetectionWorkspace
+	{
+	public:
+		DetectionWorkspace();
+
+		/** \brief  let all image buffers allocate their memory with the given allocator, e.g. to count allocations.
+		* the buffers get released, the allocator must outlive the workspace.
+		* \param allocator the allocator, 0 for the default one
+		*/
+		void setAllocator(cv::MatAllocator* allocator);
+
+		/** \brief  number of image buffers which don't use the given allocator (any more): a buffer which got another Mat assigned
+		* shares the memory of that Mat, its allocations are not seen by the allocator
+		* \param allocator the allocator passed to setAllocator
+		*/
+		int buffersNotUsingAllocator(const cv::MatAllocator* allocator);
+
+		/** memory reserved by the scratch vectors in bytes, it doesn't grow once the workspace is warmed up */
+		size_t vectorCapacity() const;
+
+		/** per image buffers, indexed by the image number (front, side) */
+		std::vector<cv::Mat> fullRes; ///< the input images in full resolution (no copy)
+		std::vector<cv::Mat> originals; ///< input images scaled down to the detection size
+		std::vector<cv::Mat> preprocessed; ///< smoothed images
+		std::vector<cv::Mat> chromaCr, chromaCb; ///< smoothed chroma planes, also cached for the color threshold trackbar
+		std::vector<cv::Mat> originalsHalf; ///< input images at half the detection size, for the chroma planes at half resolution
+		std::vector<cv::Mat> skin; ///< skin mask before the erosion
+		std::vector<cv::Mat> skinHalf; ///< skin mask of the chroma planes at half resolution
+		std::vector<cv::Mat> faceExtracted; ///< eroded skin mask
+		std::vector<cv::Mat> coarse, coarseLabels; ///< coarse copy of the skin mask and its labels, to find the face region
+		std::vector<cv::Mat> labels; ///< label image of the skin mask inside of the face region
+		std::vector<cv::Mat> faceMask; ///< mask of the face region
+		std::vector<cv::Mat> faceContourTmp; ///< copy of the face mask, findContours changes its input
+		std::vector<cv::Mat> stripBlurred, stripSkin; ///< full resolution strips to refine the face borders
+		std::vector<cv::Mat> alignTransform; ///< affine transformations which align the images
+		std::vector<cv::Mat> texturePrefiltered; ///< region of a texture in full resolution, reduced to about twice the texture size
+		std::vector<cv::Mat> textures; ///< the resulting textures
+
+		std::vector<BinaryMask> stripEroded; ///< eroded skin mask of the strip, bit-packed
+		std::vector<RunLengthMask> skinRuns; ///< run-length encoding of the rows of the eroded skin mask which the border searches query
+		std::vector<std::vector<RegionInfo> > skinRegions; ///< foreground regions of the skin mask
+		std::vector<std::vector<RegionInfo> > componentRegions; ///< holes of the skin mask
+		std::vector<std::vector<RegionInfo> > coarseSkinRegions, coarseHoles; ///< regions of the coarse skin mask
+		std::vector<std::vector<std::vector<cv::Point> > > faceContours; ///< outline of the face
+		std::vector<RegionLabeller> labellers; ///< scratch memory of the labelling
+		PolygonSimplifier profileSimplifier; ///< simplifies the outline of the face in the side image
+		std::vector<cv::Point> profilePolygon; ///< the simplified outline
+
+		cv::Mat erodeElement; ///< structuring element of the erosion of the skin mask
+
+	private:
+		/** all image buffers, to set the allocator */
+		std::vector<cv::Mat*> getImageBuffers();
+	};
+}
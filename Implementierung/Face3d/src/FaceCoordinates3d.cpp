@@ -11,23 +11,28 @@ namespace Face3D
 	
 	void FaceCoordinates3d::fromFile(const std::string& fn)
 	{
-		std::ifstream f(fn.c_str());
-
-		// order (must be the same in both programs!): leftEye, rightEye, nose, mouth
-		m_Points[LeftEye] = fileToPoint(f);
-		m_Points[RightEye] = fileToPoint(f);
-		m_Points[Nose] = fileToPoint(f);
-		m_Points[Mouth] = fileToPoint(f);
-		m_Points[Chin] = fileToPoint(f);
-		m_Points[FaceDimensions] = fileToPoint(f);
-		m_Points[TextureLeftEye] = fileToPoint(f);
-		m_Points[TextureRightEye] = fileToPoint(f);
-		m_Points[TextureChin] = fileToPoint(f);
+		GeometryRecord record;
+		readGeometry(fn, record);
+		fromRecord(record);
+	}
+
+
+	void FaceCoordinates3d::fromRecord(const GeometryRecord& record)
+	{
+		m_Points[LeftEye] = recordToPoint(record, GeometryFormat::LeftEye);
+		m_Points[RightEye] = recordToPoint(record, GeometryFormat::RightEye);
+		m_Points[Nose] = recordToPoint(record, GeometryFormat::Nose);
+		m_Points[Mouth] = recordToPoint(record, GeometryFormat::Mouth);
+		m_Points[Chin] = recordToPoint(record, GeometryFormat::Chin);
+		m_Points[FaceDimensions] = recordToPoint(record, GeometryFormat::FaceDimensions);
+		m_Points[TextureLeftEye] = recordToPoint(record, GeometryFormat::TextureLeftEye);
+		m_Points[TextureRightEye] = recordToPoint(record, GeometryFormat::TextureRightEye);
+		m_Points[TextureChin] = recordToPoint(record, GeometryFormat::TextureChin);
 		//m_Points[TextureChin].y = glm::clamp(m_Points[TextureChin].y, 0.0f, 0.10f); // Our model cant rly be extended at the chin.
 	}
 
 
-	glm::vec3 FaceCoordinates3d::fileToPoint(std::ifstream& f)
+	glm::vec3 FaceCoordinates3d::recordToPoint(const GeometryRecord& record, GeometryFormat::PointId id)
 	{
 		/*
 		coordinates are different between detection and modelling
@@ -40,9 +45,9 @@ namespace Face3D
 
 		glm::vec3 p;
 
-		f >> p.z;
-		f >> p.y;
-		f >> p.x;
+		p.z = static_cast<float>(record.points[id][0]);
+		p.y = static_cast<float>(record.points[id][1]);
+		p.x = static_cast<float>(record.points[id][2]);
 
 		return p; 
 	}
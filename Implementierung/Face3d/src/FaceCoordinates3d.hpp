@@ -1,7 +1,7 @@
 #pragma once
 
 #include "GLHeader.hpp"
-#include <fstream>
+#include "GeometryFormat.hpp"
 
 
 namespace Face3D
@@ -15,14 +15,17 @@ namespace Face3D
 		/** specify the point (e.g. nose) and get 3d coordinates of it */
 		glm::vec3 getPoint(FacialPoints3d type) const;
 
-		/** ipc - deserialize data */
+		/** ipc - deserialize data (binary, see GeometryFormat.hpp), throws if the file is missing or invalid */
 		void fromFile(const std::string& fn);
 
+		/** take the points of a record of the detection */
+		void fromRecord(const GeometryRecord& record);
+
 	private:
 		/** 3d coordinates of facial point (e.g. nose) */
 		glm::vec3 m_Points[InvalidPoint];
 
-		/** load a single point from a file */
-		glm::vec3 fileToPoint(std::ifstream& f);
+		/** a single point of the record, converted into the coordinates of the modelling */
+		static glm::vec3 recordToPoint(const GeometryRecord& record, GeometryFormat::PointId id);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include "GeometryFormat.hpp"
+
+/*
+The result of the detection as it is handed to the viewer without files: the geometry record and the textures, whose
+pixels are not encoded. Neither OpenCV nor OpenGL is needed to use it, so the detection and the modelling side both
+include it. The detection publishes it to the shared memory channel (ResultChannel.hpp, FaceDetection --channel), the
+viewer builds its model directly from the slot (FaceModelling --channel). Without a channel the ipc files are used.
+*/
+
+namespace Face3D
+{
+	/** an image in memory with 8 bit BGR pixels, e.g. the data of a cv::Mat of type CV_8UC3. the memory is not owned. */
+	struct ImageView
+	{
+		ImageView() : data(0), width(0), height(0), step(0){}
+		ImageView(const unsigned char* d, int w, int h, size_t s) : data(d), width(w), height(h), step(s){}
+
+		const unsigned char* data;
+		int width, height;
+		size_t step; ///< bytes from one row to the next
+	};
+
+	/** geometry and textures of a detected face, the images must stay valid until they are uploaded */
+	struct FaceData
+	{
+		GeometryRecord geometry;
+		ImageView textureFront;
+		ImageView textureSide;
+	};
+}
@@ -1,10 +1,25 @@
 #include <opencv2/opencv.hpp>
 #include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
 #include "Common.hpp"
 #include "Detection.hpp"
 #include "FaceGeometry.hpp"
+#include "Benchmark.hpp"
+#include "FaceTracker.hpp"
+#include "ResultCache.hpp"
+#include "FileUtils.hpp"
+#include "BatchProcessor.hpp"
+#include "ImageLoader.hpp"
+#include "StageTimer.hpp"
+#include "ResultChannel.hpp"
+#include "GeometryStore.hpp"
 #include <Windows.h>
 
+/** no message boxes when running without gui */
+static bool g_Headless = false;
+
 /** show error message to user */
 void showErrorMsg(const std::string& txt)
 {
@@ -12,39 +27,379 @@ void showErrorMsg(const std::string& txt)
 
 	// on win32: show message box
 #ifdef _WIN32
-	MessageBoxA(0, txt.c_str(), "Face3d: error message", MB_OK);
+	if (!g_Headless)
+	{
+		MessageBoxA(0, txt.c_str(), "Face3d: error message", MB_OK);
+	}
 #endif
 }
 
+/** write the stage timings, if they were collected */
+void writeProfile(const std::string& prefix)
+{
+	if (prefix.empty())
+	{
+		return;
+	}
+
+	Face3D::StageProfiler& profiler = Face3D::StageProfiler::Instance();
+	profiler.printSummary();
+	if (!profiler.writeSummary(prefix + ".json") || !profiler.writeChromeTrace(prefix + ".trace.json"))
+	{
+		throw std::exception("couldn't write the profile");
+	}
+	std::cout << "stage timings written to " << prefix << ".json, trace (chrome://tracing) to " << prefix << ".trace.json\n";
+}
+
+/** write an image file as a whole, the viewer may read it at any time */
+bool writeImageFile(const std::string& fn, const cv::Mat& img)
+{
+	// the extension selects the format, the temporary file keeps it
+	const size_t dot = fn.rfind('.');
+	const std::string tmpFn = fn.substr(0, dot) + ".tmp" + fn.substr(dot);
+	if (!cv::imwrite(tmpFn, img) || !Face3D::replaceFile(tmpFn, fn))
+	{
+		std::remove(tmpFn.c_str());
+		return false;
+	}
+	return true;
+}
+
+/** print count, min, mean and max of one column of a batch store, only this column is read */
+bool scanStore(const std::string& fn, const std::string& columnName)
+{
+	const Face3D::GeometryStoreReader store(fn);
+	const int col = store.findColumn(columnName);
+	if (col < 0)
+	{
+		std::cout << "no column " << columnName << ", the columns are:";
+		for (int i = 0; i < store.columnCount(); ++i)
+		{
+			std::cout << " " << store.columnName(i);
+		}
+		std::cout << "\n";
+		return false;
+	}
+
+	std::vector<double> values;
+	store.readColumn(col, values);
+	double minVal = 0.0, maxVal = 0.0, sum = 0.0;
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		minVal = i == 0 || values[i] < minVal ? values[i] : minVal;
+		maxVal = i == 0 || values[i] > maxVal ? values[i] : maxVal;
+		sum += values[i];
+	}
+	std::cout << columnName << ": " << values.size() << " rows, min " << minVal << ", mean " << (values.empty() ? 0.0 : sum / values.size()) << ", max " << maxVal << "\n";
+	return true;
+}
+
+/** show command line usage */
+void showUsage()
+{
+	std::cout << "Usage: FaceDetection [options] [front side]\n"
+		<< "  --video         front and side are videos (files or camera ids): detect on keyframes, track the points in between\n"
+		<< "  --keyframe N    video only: run the full detection at least every N frames (default 30)\n"
+		<< "  --headless      run without any window, the values below replace the gui\n"
+		<< "  --threshold N   color threshold [0..20] (default 10)\n"
+		<< "  --top P         additional texture above the eyes in percent (default 70)\n"
+		<< "  --bottom P      additional texture below the chin in percent (default 50)\n"
+		<< "  --preprocess M  headless only: smoothing before the skin segmentation, bgr (default), chroma or half (chroma planes at half resolution)\n"
+		<< "  --size N        headless only: size of the image the face is detected in (default 320), the textures use the full resolution\n"
+		<< "  --decode-size N decode JPEG files reduced by 2, 4 or 8 as long as the smaller side stays >= N (default 640, 0: full resolution)\n"
+		<< "  --repeat N      headless only: run the detection N times and report pairs/sec\n"
+		<< "  --no-cache      headless only: always run the detection, don't use the result cache\n"
+		<< "  --cache-size MB max. size of the result cache (default 256)\n"
+		<< "  --batch INPUT   process all pairs of a directory (<name>Front.jpg, <name>Side.jpg) or a manifest (.txt, lines \"front side [name]\")\n"
+		<< "  --out DIR       batch only: output directory, one subdirectory per pair (default batch)\n"
+		<< "  --workers N     batch only: number of detection threads (default 4)\n"
+		<< "  --scan FILE COL print count, min, mean and max of a column of a batch store (<out>/faceGeometry.col, e.g. nose.x) and exit\n"
+		<< "  --channel NAME  publish the results to the shared memory channel NAME instead of the ipc files (FaceModelling --channel NAME)\n"
+		<< "  --profile P     time the pipeline stages, write a summary with histograms (P.json) and a Chrome trace (P.trace.json)\n"
+		<< "  --benchmark     run the micro benchmarks on the front image (decoding, skin segmentation, erosion) and exit\n"
+		<< "  --check-allocations  run the detection repeatedly and check that the buffers are reused, then exit\n";
+}
+
 /** main function, reading from input directory, writing to ipc directory */
 int main(int argc, char** argv)
 {
 	try
 	{
-		// read front and side image
-		cv::Mat front = cv::imread("input/haraldFront.jpg");
-		cv::Mat side = cv::imread("input/haraldSide.jpg");
+		// parse command line
+		std::string frontFn = "input/haraldFront.jpg";
+		std::string sideFn = "input/haraldSide.jpg";
+		Face3D::Detection::DetectFaceOptions options;
+		int repeat = 1;
+		bool benchmark = false;
+		bool checkAllocations = false;
+		bool video = false;
+		bool useCache = true;
+		std::string profilePrefix;
+		std::string batchInput;
+		std::string channelName;
+		Face3D::BatchOptions batchOptions;
+		size_t cacheMB = 256;
+		Face3D::FaceTracker::Options trackerOptions;
+		int numPositional = 0;
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+			if (arg == "--headless")
+			{
+				g_Headless = true;
+			}
+			else if (arg == "--threshold" && hasValue)
+			{
+				options.colorThreshold = atoi(argv[++i]);
+			}
+			else if (arg == "--top" && hasValue)
+			{
+				options.addTextureTop = atoi(argv[++i]) / 100.0;
+			}
+			else if (arg == "--bottom" && hasValue)
+			{
+				options.addTextureBottom = atoi(argv[++i]) / 100.0;
+			}
+			else if (arg == "--preprocess" && hasValue)
+			{
+				const std::string mode = argv[++i];
+				options.preprocessing = mode == "chroma" ? Face3D::Detection::PreprocessChroma : mode == "half" ? Face3D::Detection::PreprocessChromaHalf : Face3D::Detection::PreprocessBgr;
+			}
+			else if (arg == "--size" && hasValue)
+			{
+				const int detectionSize = atoi(argv[++i]);
+				options.detectionSize = detectionSize > 0 ? detectionSize : 0;
+			}
+			else if (arg == "--decode-size" && hasValue)
+			{
+				const int decodeSize = atoi(argv[++i]);
+				batchOptions.decodeSize = decodeSize > 0 ? decodeSize : 0;
+			}
+			else if (arg == "--repeat" && hasValue)
+			{
+				repeat = atoi(argv[++i]);
+				repeat = repeat < 1 ? 1 : repeat;
+			}
+			else if (arg == "--no-cache")
+			{
+				useCache = false;
+			}
+			else if (arg == "--cache-size" && hasValue)
+			{
+				const int mb = atoi(argv[++i]);
+				cacheMB = mb > 0 ? mb : 0;
+			}
+			else if (arg == "--batch" && hasValue)
+			{
+				g_Headless = true;
+				batchInput = argv[++i];
+			}
+			else if (arg == "--out" && hasValue)
+			{
+				batchOptions.outDir = argv[++i];
+			}
+			else if (arg == "--scan" && i + 2 < argc)
+			{
+				g_Headless = true;
+				const std::string fn = argv[++i];
+				const std::string column = argv[++i];
+				return scanStore(fn, column) ? 0 : 1;
+			}
+			else if (arg == "--workers" && hasValue)
+			{
+				batchOptions.workers = atoi(argv[++i]);
+			}
+			else if (arg == "--channel" && hasValue)
+			{
+				channelName = argv[++i];
+			}
+			else if (arg == "--profile" && hasValue)
+			{
+				profilePrefix = argv[++i];
+				Face3D::StageProfiler::Instance().setEnabled(true);
+			}
+			else if (arg == "--benchmark")
+			{
+				g_Headless = true;
+				benchmark = true;
+			}
+			else if (arg == "--video")
+			{
+				g_Headless = true;
+				video = true;
+			}
+			else if (arg == "--keyframe" && hasValue)
+			{
+				trackerOptions.keyframeInterval = atoi(argv[++i]);
+			}
+			else if (arg == "--check-allocations")
+			{
+				g_Headless = true;
+				checkAllocations = true;
+			}
+			else if (arg[0] != '-' && numPositional < 2)
+			{
+				(numPositional++ == 0 ? frontFn : sideFn) = arg;
+			}
+			else
+			{
+				showUsage();
+				return 1;
+			}
+		}
+
+		// batch: all pairs in one process, the results don't go to ipc/
+		if (!batchInput.empty())
+		{
+			std::vector<Face3D::ImagePair> pairs;
+			if (!Face3D::findImagePairs(batchInput, pairs))
+			{
+				throw std::exception("couldn't read the batch manifest");
+			}
+			batchOptions.detectOptions = options;
+			const int failed = Face3D::processBatch(pairs, batchOptions);
+			writeProfile(profilePrefix);
+			return failed == 0 ? 0 : 1;
+		}
+
+		// the files the result is written to, the second program reads them
+		Face3D::ResultCache::ResultFiles resultFiles;
+		resultFiles.geometry = "ipc/faceGeometry.bin";
+		resultFiles.textureFront = "ipc/front.jpg";
+		resultFiles.textureSide = "ipc/side.jpg";
+
+		// read front and side image (videos are opened by the tracker)
+		cv::Mat front, side;
+		std::vector<uchar> frontBytes, sideBytes;
+		if (!video)
+		{
+			const std::string* fns[2] = { &frontFn, &sideFn };
+			std::vector<uchar>* bytes[2] = { &frontBytes, &sideBytes };
+			for (int i = 0; i < 2; ++i)
+			{
+				if (!Face3D::readFile(*fns[i], *bytes[i]))
+				{
+					const std::string msg = "couldn't read " + *fns[i];
+					throw std::exception(msg.c_str());
+				}
+			}
+		}
+
+		// same images and parameters as an earlier run: copy its result, no decoding, no detection.
+		// only for single headless runs, with the gui the parameters are chosen interactively
+		std::unique_ptr<Face3D::ResultCache> cache;
+		uint64 cacheKey = 0;
+		if (useCache && g_Headless && channelName.empty() && !video && !benchmark && !checkAllocations && repeat == 1 && !frontBytes.empty() && !sideBytes.empty())
+		{
+			cache.reset(new Face3D::ResultCache("cache", cacheMB * 1024 * 1024));
+			cacheKey = Face3D::ResultCache::computeKey(frontBytes, sideBytes, options, batchOptions.decodeSize);
+			const bool hit = cache->lookup(cacheKey, resultFiles);
+			std::cout << "result cache " << (hit ? "hit" : "miss") << " (" << cache->hits() << " hits, " << cache->misses() << " misses, " << cache->size() / 1024 << " KB)\n";
+			if (hit)
+			{
+				return 0;
+			}
+		}
+
+		// camera photos are decoded at a reduced size, the pipeline doesn't need all the pixels
+		front = Face3D::decodeImage(frontBytes, batchOptions.decodeSize);
+		side = Face3D::decodeImage(sideBytes, batchOptions.decodeSize);
+
+		if (benchmark)
+		{
+			Face3D::benchmarkDecode(frontFn);
+			Face3D::benchmarkSkinSegmentation(front);
+			Face3D::benchmarkPreprocessing(front);
+			Face3D::benchmarkMorphology(front);
+			return 0;
+		}
+
+		if (checkAllocations)
+		{
+			return Face3D::checkAllocations(front, side, options) ? 0 : 1;
+		}
+
+		// the viewer runs as a separate process and takes the newest result from the shared memory
+		std::unique_ptr<Face3D::ResultChannel> channel;
+		std::function<void(const Face3D::Detection::DetectFaceResult&)> publish;
+		if (!channelName.empty())
+		{
+			channel.reset(new Face3D::ResultChannel(channelName, Face3D::ResultChannel::Create));
+			publish = [&channel](const Face3D::Detection::DetectFaceResult& result){ channel->publish(result.toFaceData()); };
+		}
 
 		// detect face geometry
-		Face3D::Detection detection(front, side);
-		Face3D::Detection::DetectFaceResult detectFaceResult = detection.detectFace();
+		Face3D::Detection::DetectFaceResult detectFaceResult;
+		if (video)
+		{
+			// each frame pair gets published, the result of the last one gets saved
+			trackerOptions.detectOptions = options;
+			if (!Face3D::processVideo(frontFn, sideFn, trackerOptions, detectFaceResult, publish))
+			{
+				throw std::exception("couldn't process any frame of the videos");
+			}
+		}
+		else if (g_Headless)
+		{
+			// all runs share the buffers, only the first one allocates them
+			std::shared_ptr<Face3D::DetectionWorkspace> workspace = std::make_shared<Face3D::DetectionWorkspace>();
+			const int64 start = cv::getTickCount();
+			for (int i = 0; i < repeat; ++i)
+			{
+				Face3D::Detection detection(front, side, workspace);
+				detectFaceResult = detection.detectFaceHeadless(options);
+			}
+			const double secs = (cv::getTickCount() - start) / cv::getTickFrequency();
+			std::cout << repeat << " image pair(s) in " << secs << "s: " << repeat / secs << " pairs/sec\n";
+		}
+		else
+		{
+			Face3D::Detection detection(front, side);
+			detectFaceResult = detection.detectFace();
+		}
+
+		// the channel only exists as long as this process: keep it open until the user is done with the viewer
+		if (channel)
+		{
+			if (!video)
+			{
+				publish(detectFaceResult);
+			}
+			writeProfile(profilePrefix);
+			std::cout << "result published to channel " << channelName << ", press ENTER to close it\n";
+			getchar();
+			return 0;
+		}
 
-		// save as file so that the second program can load the geometry to adjust the generic 3d model
-		detectFaceResult.faceGeometry.toFile("ipc/faceGeometry.txt");
-		cv::imwrite("ipc/front.jpg",detectFaceResult.textureFront);
-		cv::imwrite("ipc/side.jpg", detectFaceResult.textureSide);
+		// save as file so that the second program can load the geometry to adjust the generic 3d model.
+		// the viewer reloads the result when the geometry changes, so it is written after the textures.
+		// only a complete result goes into the cache
+		if (!writeImageFile(resultFiles.textureFront, detectFaceResult.textureFront) || !writeImageFile(resultFiles.textureSide, detectFaceResult.textureSide))
+		{
+			throw std::exception("couldn't write the textures to ipc/");
+		}
+		detectFaceResult.faceGeometry.toFile(resultFiles.geometry);
+
+		if (cache)
+		{
+			cache->store(cacheKey, resultFiles);
+		}
+
+		writeProfile(profilePrefix);
 
 	}
 	catch (std::exception e)
-	{	
+	{
 		showErrorMsg(e.what());
+		return 1;
 	}
 	catch (...)
 	{
-		showErrorMsg("unknown error");		
+		showErrorMsg("unknown error");
+		return 1;
 	}
-	
+
 
 	return 0;
 }
-
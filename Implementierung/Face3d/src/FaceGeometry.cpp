@@ -1,5 +1,4 @@
 #include "FaceGeometry.hpp"
-#include <fstream>
 
 namespace Face3D
 {
@@ -30,29 +29,36 @@ namespace Face3D
 
 
 
-	void FaceGeometry::toFile(const std::string& fn)
+	GeometryRecord FaceGeometry::toRecord() const
 	{
-		std::ofstream f(fn.c_str());
-
-		// order (must be the same in both programs!): leftEye, rightEye, nose, mouth, chin
-		pointToFile(f, leftEye);
-		pointToFile(f, rightEye);
-		pointToFile(f, nose);
-		pointToFile(f, mouth);
-		pointToFile(f, chin);
-		pointToFile(f, faceDimensions);
-		pointToFile(f, m_DetectedPoints[TextureLeftEye]);
-		pointToFile(f, m_DetectedPoints[TextureRightEye]);
-		pointToFile(f, m_DetectedPoints[TextureChin]);
+		GeometryRecord res;
+		pointToRecord(res, GeometryFormat::LeftEye, leftEye);
+		pointToRecord(res, GeometryFormat::RightEye, rightEye);
+		pointToRecord(res, GeometryFormat::Nose, nose);
+		pointToRecord(res, GeometryFormat::Mouth, mouth);
+		pointToRecord(res, GeometryFormat::Chin, chin);
+		pointToRecord(res, GeometryFormat::FaceDimensions, faceDimensions);
+		pointToRecord(res, GeometryFormat::TextureLeftEye, m_DetectedPoints[TextureLeftEye]);
+		pointToRecord(res, GeometryFormat::TextureRightEye, m_DetectedPoints[TextureRightEye]);
+		pointToRecord(res, GeometryFormat::TextureChin, m_DetectedPoints[TextureChin]);
+		return res;
+	}
+
+
+
+	void FaceGeometry::toFile(const std::string& fn) const
+	{
+		// the point table of the file says which point is which, there is no order both programs have to agree on
+		writeGeometry(fn, toRecord());
 	}
 
 
 	
-	void FaceGeometry::pointToFile(std::ofstream& f, const cv::Point3d& p)
+	void FaceGeometry::pointToRecord(GeometryRecord& record, GeometryFormat::PointId id, const cv::Point3d& p)
 	{
-		f << p.x << "\n";
-		f << p.y << "\n";
-		f << p.z << "\n";
+		record.points[id][0] = p.x;
+		record.points[id][1] = p.y;
+		record.points[id][2] = p.z;
 	}
 
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <opencv2/opencv.hpp>
+#include "GeometryFormat.hpp"
 
 namespace Face3D
 {
@@ -32,8 +33,11 @@ namespace Face3D
 		/** combine the points into 3d points */
 		void merge3d();
 
-		/** ipc - serialize current object state to file */
-		void toFile(const std::string& fn);
+		/** the points which are passed to the modelling program */
+		GeometryRecord toRecord() const;
+
+		/** ipc - serialize current object state to file (binary, see GeometryFormat.hpp) */
+		void toFile(const std::string& fn) const;
 
 		
 
@@ -43,9 +47,8 @@ namespace Face3D
 		cv::Rect sideSkinRegion; ///< region of the skin in the side image
 		cv::Rect frontSkinRegion; ///< region of the skin in the front image
 
-
-		/** save a single point to a file */
-		void pointToFile(std::ofstream& f, const cv::Point3d& p);
+		/** store a single point in the record */
+		static void pointToRecord(GeometryRecord& record, GeometryFormat::PointId id, const cv::Point3d& p);
 	};
 
 	
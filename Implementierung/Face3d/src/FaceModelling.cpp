@@ -1,6 +1,8 @@
 #include <iostream>
+#include <string>
 #include "FaceCoordinates3d.hpp"
 #include "Viewer.hpp"
+#include "ResultChannel.hpp"
 
 
 /** main function for the modelling program */
@@ -9,9 +11,27 @@ int main(int argc, char** argv)
 
 	try
 	{		
+		// --channel NAME: take the result from the shared memory of a running detection instead of the ipc files
+		std::string channelName;
+		for (int i = 1; i + 1 < argc; ++i)
+		{
+			if (std::string(argv[i]) == "--channel")
+			{
+				channelName = argv[i + 1];
+			}
+		}
+
 		Face3D::Viewer viewer;
 		viewer.initOpenGL();
-		viewer.run();
+		if (channelName.empty())
+		{
+			viewer.run();
+		}
+		else
+		{
+			const Face3D::ResultChannel channel(channelName, Face3D::ResultChannel::Open);
+			viewer.run(channel);
+		}
 	}
 	catch (std::exception e)
 	{
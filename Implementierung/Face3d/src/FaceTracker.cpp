@@ -0,0 +1,252 @@
+#include "FaceTracker.hpp"
+#include "StageTimer.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+
+
+namespace Face3D
+{
+	namespace
+	{
+		/** size of the coordinate system of the face geometry, same as Detection::imgSize */
+		const int geometrySize = 320;
+
+		/** the points which get tracked, the other ones are moved along with them */
+		const FaceGeometry::DetectedPoints frontPoints[] = { FaceGeometry::FrontLeftEye, FaceGeometry::FrontRightEye, FaceGeometry::FrontMouth };
+		const FaceGeometry::DetectedPoints sidePoints[] = { FaceGeometry::SideEye, FaceGeometry::SideNoseTip, FaceGeometry::SideChin };
+
+		/** sub-pixel position of a maximum: vertex of the parabola through the three values */
+		double subPixelOffset(float prev, float center, float next)
+		{
+			const double denom = prev - 2.0 * center + next;
+			return denom < 0.0 ? 0.5 * (prev - next) / denom : 0.0;
+		}
+
+		/** open a video file, or a camera if the name is a number */
+		void openVideo(cv::VideoCapture& video, const std::string& fn)
+		{
+			const bool isCamera = !fn.empty() && fn.find_first_not_of("0123456789") == std::string::npos;
+			if (isCamera ? !video.open(atoi(fn.c_str())) : !video.open(fn))
+			{
+				const std::string msg = "couldn't open video " + fn;
+				throw std::exception(msg.c_str());
+			}
+		}
+	}
+
+
+
+	FaceTracker::FaceTracker(const Options& options)
+		: m_Options(options)
+		, m_Workspace(std::make_shared<DetectionWorkspace>())
+		, m_FramesSinceKeyframe(options.keyframeInterval)
+		, m_IsTracking(false)
+	{
+	}
+
+
+
+	Detection::DetectFaceResult FaceTracker::process(const cv::Mat& front, const cv::Mat& side, bool& keyframe)
+	{
+		const cv::Mat frontSquare = prepareFrame(front, 0);
+		const cv::Mat sideSquare = prepareFrame(side, 1);
+
+		// the detection object is cheap, all buffers are in the workspace
+		Detection detection(frontSquare, sideSquare, m_Workspace);
+
+		++m_FramesSinceKeyframe;
+		keyframe = !m_IsTracking || m_FramesSinceKeyframe >= m_Options.keyframeInterval || !track();
+		if (!keyframe)
+		{
+			return detection.createResultFromPoints(m_Points, m_Options.detectOptions);
+		}
+
+		// full detection, if it fails the next frame is a keyframe again
+		m_IsTracking = false;
+		Detection::DetectFaceResult res = detection.detectFaceHeadless(m_Options.detectOptions);
+		m_Points = res.detectedGeometry;
+		m_IsTracking = startTracking(m_Points);
+		m_FramesSinceKeyframe = 0;
+		return res;
+	}
+
+
+
+	cv::Mat FaceTracker::prepareFrame(const cv::Mat& frame, size_t imgNr)
+	{
+		ScopedStageTimer timer("prepareFrame", static_cast<int>(imgNr));
+
+		if (frame.empty())
+		{
+			throw std::exception("empty video frame");
+		}
+
+		// the tracked points and the detection must see the same undistorted image
+		const int side = std::min(frame.cols, frame.rows);
+		const cv::Mat square = frame(cv::Rect((frame.cols - side) / 2, (frame.rows - side) / 2, side, side));
+
+		cv::resize(square, m_Small[imgNr], cv::Size(geometrySize, geometrySize), 0, 0, cv::INTER_AREA);
+		cv::cvtColor(m_Small[imgNr], m_Gray[imgNr], CV_BGR2GRAY);
+		return square;
+	}
+
+
+
+	bool FaceTracker::startTracking(const FaceGeometry& detected)
+	{
+		m_Tracked.clear();
+		const int half = m_Options.templateSize / 2;
+		const cv::Rect imgRect(0, 0, geometrySize, geometrySize);
+
+		for (size_t i = 0; i < 6; ++i)
+		{
+			TrackedPoint tracked;
+			tracked.imgNr = i < 3 ? 0 : 1;
+			tracked.point = i < 3 ? frontPoints[i] : sidePoints[i - 3];
+
+			// the template must be inside of the image and must have some structure, else the correlation is meaningless
+			const cv::Point center = detected.getDetectedPointInt(tracked.point);
+			const cv::Rect rect(center.x - half, center.y - half, m_Options.templateSize, m_Options.templateSize);
+			if ((rect & imgRect).area() != rect.area())
+			{
+				return false;
+			}
+			m_Gray[tracked.imgNr](rect).copyTo(tracked.patch);
+
+			cv::Scalar mean, stddev;
+			cv::meanStdDev(tracked.patch, mean, stddev);
+			if (stddev[0] < 2.0)
+			{
+				return false;
+			}
+
+			m_Tracked.push_back(tracked);
+		}
+
+		return true;
+	}
+
+
+
+	bool FaceTracker::track()
+	{
+		ScopedStageTimer timer("tracking");
+
+		// search all points first, the geometry only gets updated if none of them is lost
+		FaceGeometry points = m_Points;
+		cv::Point2d shift[2];
+		for (size_t i = 0; i < m_Tracked.size(); ++i)
+		{
+			const cv::Point2d last = m_Points.getDetectedPoint(m_Tracked[i].point);
+			cv::Point2d pos = last;
+			if (!trackPoint(m_Tracked[i], pos))
+			{
+				return false;
+			}
+			points.setDetectedPoint(m_Tracked[i].point, pos);
+			shift[m_Tracked[i].imgNr] += (pos - last) * (1.0 / 3.0);
+		}
+
+		// the face borders are not tracked (no structure), they move with the mean of the other points of the image
+		const cv::Point2d frontLeftCheek = points.getDetectedPoint(FaceGeometry::FrontLeftCheek) + shift[0];
+		const cv::Point2d frontRightCheek = points.getDetectedPoint(FaceGeometry::FrontRightCheek) + shift[0];
+		const cv::Point2d sideBack = points.getDetectedPoint(FaceGeometry::SideBack) + shift[1];
+		points.setDetectedPoint(FaceGeometry::FrontLeftCheek, frontLeftCheek);
+		points.setDetectedPoint(FaceGeometry::FrontRightCheek, frontRightCheek);
+		points.setDetectedPoint(FaceGeometry::SideBack, sideBack);
+
+		m_Points = points;
+		return true;
+	}
+
+
+
+	bool FaceTracker::trackPoint(const TrackedPoint& tracked, cv::Point2d& pos)
+	{
+		// search window: template size plus the max. movement in each direction
+		const int half = m_Options.templateSize / 2;
+		const int r = m_Options.searchRadius;
+		const cv::Point last(cvRound(pos.x), cvRound(pos.y));
+		cv::Rect window(last.x - half - r, last.y - half - r, m_Options.templateSize + 2 * r, m_Options.templateSize + 2 * r);
+		window &= cv::Rect(0, 0, geometrySize, geometrySize);
+		if (window.width < m_Options.templateSize || window.height < m_Options.templateSize)
+		{
+			return false;
+		}
+
+		cv::matchTemplate(m_Gray[tracked.imgNr](window), tracked.patch, m_MatchResult, CV_TM_CCOEFF_NORMED);
+		double maxScore = 0.0;
+		cv::Point maxLoc;
+		cv::minMaxLoc(m_MatchResult, 0, &maxScore, 0, &maxLoc);
+		if (maxScore < m_Options.minScore)
+		{
+			return false;
+		}
+
+		// refine to sub-pixel accuracy, keeps the points from jittering by a whole pixel
+		double dx = 0.0, dy = 0.0;
+		if (maxLoc.x > 0 && maxLoc.x + 1 < m_MatchResult.cols)
+		{
+			const float* row = m_MatchResult.ptr<float>(maxLoc.y);
+			dx = subPixelOffset(row[maxLoc.x - 1], row[maxLoc.x], row[maxLoc.x + 1]);
+		}
+		if (maxLoc.y > 0 && maxLoc.y + 1 < m_MatchResult.rows)
+		{
+			dy = subPixelOffset(m_MatchResult.at<float>(maxLoc.y - 1, maxLoc.x), m_MatchResult.at<float>(maxLoc.y, maxLoc.x), m_MatchResult.at<float>(maxLoc.y + 1, maxLoc.x));
+		}
+
+		pos.x = window.x + maxLoc.x + dx + half;
+		pos.y = window.y + maxLoc.y + dy + half;
+		return true;
+	}
+
+
+
+	bool processVideo(const std::string& frontFn, const std::string& sideFn, const FaceTracker::Options& options, Detection::DetectFaceResult& lastResult,
+		const std::function<void(const Detection::DetectFaceResult&)>& onResult)
+	{
+		cv::VideoCapture frontVideo, sideVideo;
+		openVideo(frontVideo, frontFn);
+		openVideo(sideVideo, sideFn);
+
+		FaceTracker tracker(options);
+		cv::Mat front, side;
+		int frames = 0, processed = 0, keyframes = 0;
+		double keyframeMs = 0.0, trackedMs = 0.0;
+		while (frontVideo.read(front) && sideVideo.read(side))
+		{
+			const int64 start = cv::getTickCount();
+			bool keyframe = true;
+			std::string error;
+			try
+			{
+				lastResult = tracker.process(front, side, keyframe);
+				++processed;
+			}
+			catch (std::exception e)
+			{
+				// e.g. no face in this frame, try again with the next one
+				error = e.what();
+			}
+			const double ms = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+
+			(keyframe ? keyframeMs : trackedMs) += ms;
+			keyframes += keyframe ? 1 : 0;
+			std::cout << "frame " << frames << (keyframe ? ": keyframe " : ": tracked ") << ms << "ms" << (error.empty() ? "" : " error: " + error) << "\n";
+			++frames;
+
+			// not part of the latency above
+			if (error.empty() && onResult)
+			{
+				onResult(lastResult);
+			}
+		}
+
+		const int tracked = frames - keyframes;
+		std::cout << frames << " frames, " << keyframes << " keyframes (avg. " << (keyframes ? keyframeMs / keyframes : 0.0) << "ms), "
+			<< tracked << " tracked (avg. " << (tracked ? trackedMs / tracked : 0.0) << "ms)\n";
+
+		return processed > 0;
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include "Detection.hpp"
+#include "DetectionWorkspace.hpp"
+#include "FaceGeometry.hpp"
+
+/*
+Video mode: the full detection only runs on keyframes. In between, the facial points are tracked by template matching
+in small windows around their last positions, and only the textures are created for each frame.
+*/
+
+namespace Face3D
+{
+	/** tracks the facial points in a front and a side video */
+	class FaceTracker
+	{
+	public:
+		/** parameters of the tracking, all sizes in the 320x320 coordinate system of the face geometry */
+		struct Options
+		{
+			Detection::DetectFaceOptions detectOptions; ///< used for the keyframes
+			int keyframeInterval = 30; ///< run the full detection at least every n frames
+			int templateSize = 21; ///< width and height of the template around each point
+			int searchRadius = 12; ///< max. movement of a point from one frame to the next
+			double minScore = 0.7; ///< normalized correlation below this value means that the point is lost
+		};
+
+		/** \brief  create a tracker, the first frame is always a keyframe
+		* \param options tracking parameters
+		*/
+		explicit FaceTracker(const Options& options);
+
+		/** \brief  process the next frame pair: full detection on keyframes or if tracking got lost, else track the points.
+		* the detection needs square images, of frames with another aspect ratio (e.g. a 16:9 webcam) the centered square is used.
+		* \param front frame of the front video
+		* \param side frame of the side video
+		* \param keyframe true if the full detection was run for this frame
+		* \return the result, the textures share their memory with the tracker and are overwritten by the next frame
+		*/
+		Detection::DetectFaceResult process(const cv::Mat& front, const cv::Mat& side, bool& keyframe);
+
+	private:
+		/** a tracked point and its template from the last keyframe */
+		struct TrackedPoint
+		{
+			FaceGeometry::DetectedPoints point;
+			size_t imgNr;
+			cv::Mat patch;
+		};
+
+		/** \brief  cut out the centered square, scale it down and convert it to gray, such that pixel coordinates are the coordinates of the face geometry
+		* \return the centered square of the frame in full resolution (no copy), the detection must use the same image
+		*/
+		cv::Mat prepareFrame(const cv::Mat& frame, size_t imgNr);
+
+		/** take the templates around the detected points, false if a point is too close to the border */
+		bool startTracking(const FaceGeometry& detected);
+
+		/** search all points in the current frames, false if one of them is lost */
+		bool track();
+
+		/** \brief  search a template in the window around its last position
+		* \param tracked the point with its template
+		* \param pos last position, the new position if found
+		* \return false if the point is lost
+		*/
+		bool trackPoint(const TrackedPoint& tracked, cv::Point2d& pos);
+
+		Options m_Options;
+		std::shared_ptr<DetectionWorkspace> m_Workspace; ///< buffers of the detection, reused for all frames
+		FaceGeometry m_Points; ///< the detected or tracked points in the (not aligned) frames
+		std::vector<TrackedPoint> m_Tracked;
+		cv::Mat m_Small[2], m_Gray[2]; ///< current frames in the coordinate system of the face geometry
+		cv::Mat m_MatchResult; ///< correlation of a template inside the search window
+		int m_FramesSinceKeyframe;
+		bool m_IsTracking;
+	};
+
+	/** \brief  run the tracker on a front and a side video (files or camera ids) until one of them ends, print the latency per frame
+	* \param frontFn front video
+	* \param sideFn side video
+	* \param options tracking parameters
+	* \param lastResult result of the last frame
+	* \param onResult called with the result of each frame, e.g. to publish it to the viewer
+	* \return false if no frame could be processed
+	*/
+	bool processVideo(const std::string& frontFn, const std::string& sideFn, const FaceTracker::Options& options, Detection::DetectFaceResult& lastResult,
+		const std::function<void(const Detection::DetectFaceResult&)>& onResult = std::function<void(const Detection::DetectFaceResult&)>());
+}
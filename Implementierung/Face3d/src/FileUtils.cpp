@@ -0,0 +1,94 @@
+#include "FileUtils.hpp"
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <cstdio>
+#ifdef _WIN32
+#include <direct.h>
+#include <Windows.h>
+#endif
+
+
+namespace Face3D
+{
+	namespace
+	{
+		/** the st_mode of the file, 0 if it doesn't exist */
+		unsigned int fileMode(const std::string& fn)
+		{
+#ifdef _WIN32
+			struct _stat st;
+			return _stat(fn.c_str(), &st) == 0 ? st.st_mode : 0;
+#else
+			struct stat st;
+			return stat(fn.c_str(), &st) == 0 ? st.st_mode : 0;
+#endif
+		}
+	}
+
+
+
+	bool createDirectory(const std::string& dir)
+	{
+		// the result of mkdir doesn't tell if an existing directory or a file of this name is in the way
+#ifdef _WIN32
+		_mkdir(dir.c_str());
+#else
+		mkdir(dir.c_str(), 0755);
+#endif
+		return (fileMode(dir) & S_IFMT) == S_IFDIR;
+	}
+
+
+
+	bool readFile(const std::string& fn, std::vector<unsigned char>& bytes)
+	{
+		// a directory can be opened as a stream on some platforms, its size is nonsense
+		std::ifstream f(fn.c_str(), std::ios::binary);
+		if (!f || (fileMode(fn) & S_IFMT) != S_IFREG)
+		{
+			bytes.clear();
+			return false;
+		}
+
+		// tellg is -1 if the stream failed
+		f.seekg(0, std::ios::end);
+		const std::streamoff size = f.tellg();
+		if (size < 0)
+		{
+			bytes.clear();
+			return false;
+		}
+		bytes.resize(static_cast<size_t>(size));
+		f.seekg(0, std::ios::beg);
+		if (!bytes.empty())
+		{
+			f.read(reinterpret_cast<char*>(&bytes[0]), bytes.size());
+		}
+		return !f.fail();
+	}
+
+
+
+	bool writeFile(const std::string& fn, const std::vector<unsigned char>& bytes)
+	{
+		std::ofstream f(fn.c_str(), std::ios::binary);
+		if (!bytes.empty())
+		{
+			f.write(reinterpret_cast<const char*>(&bytes[0]), bytes.size());
+		}
+		return !f.fail();
+	}
+
+
+
+	bool replaceFile(const std::string& src, const std::string& dst)
+	{
+		// rename() of the C runtime fails on Windows if the destination exists
+#ifdef _WIN32
+		return MoveFileExA(src.c_str(), dst.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return std::rename(src.c_str(), dst.c_str()) == 0;
+#endif
+	}
+}
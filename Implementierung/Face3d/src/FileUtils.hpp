@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Face3D
+{
+	/** \brief  create a directory
+	* \param dir the directory, its parent must exist
+	* \return true if the directory exists afterwards (also if it existed before)
+	*/
+	bool createDirectory(const std::string& dir);
+
+	/** \brief  read a whole file
+	* \param fn file name
+	* \param bytes the content of the file
+	* \return false if the file couldn't be read
+	*/
+	bool readFile(const std::string& fn, std::vector<unsigned char>& bytes);
+
+	/** \brief  write a whole file
+	* \return false if the file couldn't be written
+	*/
+	bool writeFile(const std::string& fn, const std::vector<unsigned char>& bytes);
+
+	/** \brief  rename a file, an existing file of the new name gets replaced. a reader sees either the old or the new file, never a partly written one.
+	* \param src the file, e.g. a temporary file which was just written
+	* \param dst the new name, on the same drive
+	* \return false if the file couldn't be renamed
+	*/
+	bool replaceFile(const std::string& src, const std::string& dst);
+}
@@ -0,0 +1,134 @@
+#include "GeometryFormat.hpp"
+#include "MappedFile.hpp"
+#include "FileUtils.hpp"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace Face3D
+{
+	namespace
+	{
+		/** FNV-1a (32 bit) */
+		uint32_t checksum(const unsigned char* data, size_t size)
+		{
+			uint32_t hash = 2166136261u;
+			for (size_t i = 0; i < size; ++i)
+			{
+				hash ^= data[i];
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+	}
+
+
+
+	void encodeGeometry(const GeometryRecord& record, std::vector<unsigned char>& bytes)
+	{
+		using namespace GeometryFormat;
+
+		bytes.assign(sizeof(Header) + NumPoints*sizeof(Point), 0);
+		Point* table = reinterpret_cast<Point*>(&bytes[sizeof(Header)]);
+		for (uint32_t i = 0; i < NumPoints; ++i)
+		{
+			table[i].id = i;
+			table[i].reserved = 0;
+			table[i].x = record.points[i][0];
+			table[i].y = record.points[i][1];
+			table[i].z = record.points[i][2];
+		}
+
+		Header header;
+		header.magic = magic;
+		header.version = version;
+		header.headerSize = sizeof(Header);
+		header.pointSize = sizeof(Point);
+		header.pointCount = NumPoints;
+		header.checksum = checksum(&bytes[sizeof(Header)], NumPoints*sizeof(Point));
+		memcpy(&bytes[0], &header, sizeof(Header));
+	}
+
+
+
+	void decodeGeometry(const unsigned char* data, size_t size, GeometryRecord& record)
+	{
+		using namespace GeometryFormat;
+
+		Header header;
+		if (size < sizeof(Header))
+		{
+			throw std::runtime_error("geometry file: too small");
+		}
+		memcpy(&header, data, sizeof(Header));
+		if (header.magic != magic)
+		{
+			throw std::runtime_error("geometry file: not a geometry file (magic number)");
+		}
+		if (header.version != version || header.headerSize != sizeof(Header) || header.pointSize != sizeof(Point))
+		{
+			throw std::runtime_error("geometry file: written by another version of the detection");
+		}
+		// bounded first, the product could wrap around with a 32 bit size_t
+		if (header.pointCount > (size - sizeof(Header)) / sizeof(Point) || size != sizeof(Header) + static_cast<size_t>(header.pointCount)*sizeof(Point))
+		{
+			throw std::runtime_error("geometry file: size doesn't match the point table");
+		}
+		if (checksum(data + sizeof(Header), size - sizeof(Header)) != header.checksum)
+		{
+			throw std::runtime_error("geometry file: checksum mismatch");
+		}
+
+		// the table says where each point is, the order of the entries doesn't matter
+		bool found[NumPoints] = {};
+		for (uint32_t i = 0; i < header.pointCount; ++i)
+		{
+			Point p;
+			memcpy(&p, data + sizeof(Header) + i*sizeof(Point), sizeof(Point));
+			if (p.id >= NumPoints)
+			{
+				throw std::runtime_error("geometry file: unknown point");
+			}
+			record.points[p.id][0] = p.x;
+			record.points[p.id][1] = p.y;
+			record.points[p.id][2] = p.z;
+			found[p.id] = true;
+		}
+		for (int i = 0; i < NumPoints; ++i)
+		{
+			if (!found[i])
+			{
+				throw std::runtime_error("geometry file: a point is missing");
+			}
+		}
+	}
+
+
+
+	void writeGeometry(const std::string& fn, const GeometryRecord& record)
+	{
+		std::vector<unsigned char> bytes;
+		encodeGeometry(record, bytes);
+
+		// the modelling program may read the file at any time: write a temporary file and replace the old one with it
+		const std::string tmpFn = fn + ".tmp";
+		if (!writeFile(tmpFn, bytes) || !replaceFile(tmpFn, fn))
+		{
+			std::remove(tmpFn.c_str());
+			throw std::runtime_error("couldn't write the geometry file");
+		}
+	}
+
+
+
+	void readGeometry(const std::string& fn, GeometryRecord& record)
+	{
+		const MappedFile file(fn);
+		if (!file.isOpen())
+		{
+			throw std::runtime_error("couldn't open the geometry file");
+		}
+		decodeGeometry(file.data(), file.size(), record);
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+Binary file of the face geometry (ipc/faceGeometry.bin), written by the detection and read by the modelling program.
+This header is the only description of the layout, both programs include it:
+
+	GeometryHeader      magic, version, sizes of the structures, number of points, checksum
+	GeometryPoint[n]    the point table: id and coordinates of each point
+
+All values are in the native byte order (little endian on the supported targets, x86). The file is replaced as a whole
+(written to a temporary file and renamed), a reader never sees a partly written one. The checksum (FNV-1a) covers everything behind the header, so a file which is truncated,
+still being written or written by another version is rejected instead of producing a wrong model.
+*/
+
+namespace Face3D
+{
+	namespace GeometryFormat
+	{
+		const uint32_t magic = 0x4F454746; ///< "FGEO"
+		const uint32_t version = 1; ///< increase on every change of the layout or of the meaning of the points
+
+		/** the stored points, in the coordinates of the detection (x right, y down, z from the side image) */
+		enum PointId { LeftEye, RightEye, Nose, Mouth, Chin, FaceDimensions, TextureLeftEye, TextureRightEye, TextureChin, NumPoints };
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t headerSize; ///< sizeof(Header) of the writer
+			uint32_t pointSize; ///< sizeof(Point) of the writer
+			uint32_t pointCount; ///< number of entries of the point table
+			uint32_t checksum; ///< FNV-1a of the point table
+		};
+
+		struct Point
+		{
+			uint32_t id; ///< PointId
+			uint32_t reserved; ///< 0, keeps the coordinates aligned
+			double x, y, z;
+		};
+
+		static_assert(sizeof(Header) == 24 && sizeof(Point) == 32, "the layout of the geometry file depends on the compiler");
+	}
+
+	/** all points of the geometry, the content of the file */
+	struct GeometryRecord
+	{
+		double points[GeometryFormat::NumPoints][3]; ///< x, y, z of each point, indexed by GeometryFormat::PointId
+	};
+
+	/** \brief  serialize the record: header and point table */
+	void encodeGeometry(const GeometryRecord& record, std::vector<unsigned char>& bytes);
+
+	/** \brief  deserialize and validate a record, throws if the data is no valid geometry of this version
+	* \param data the content of the file
+	* \param size number of bytes
+	* \param record the points, all of them must be in the point table
+	*/
+	void decodeGeometry(const unsigned char* data, size_t size, GeometryRecord& record);
+
+	/** \brief  write the geometry file, throws if it couldn't be written */
+	void writeGeometry(const std::string& fn, const GeometryRecord& record);
+
+	/** \brief  read the geometry file through a memory map, throws if it is missing or invalid */
+	void readGeometry(const std::string& fn, GeometryRecord& record);
+}
@@ -0,0 +1,401 @@
+#include "GeometryStore.hpp"
+#include "MappedFile.hpp"
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace Face3D
+{
+	namespace
+	{
+		using namespace GeometryStoreFormat;
+
+		/** the names of the points in the column names, in the order of GeometryFormat::PointId */
+		const char* const pointNames[GeometryFormat::NumPoints] =
+		{
+			"leftEye", "rightEye", "nose", "mouth", "chin", "faceDimensions", "textureLeftEye", "textureRightEye", "textureChin"
+		};
+
+		const char* const stageNames[GeometryStoreRow::NumStages] = { "decodeMs", "detectMs", "encodeMs" };
+
+		/** the columns in this order: pair id, x y z of each point, time of each stage */
+		const int firstPointColumn = 1;
+		const int firstStageColumn = firstPointColumn + 3 * GeometryFormat::NumPoints;
+		const int numColumns = firstStageColumn + GeometryStoreRow::NumStages;
+
+		size_t alignUp(size_t n)
+		{
+			return (n + 63) & ~static_cast<size_t>(63);
+		}
+
+		size_t valueSize(uint32_t type)
+		{
+			return type == Float32 ? 4 : 8;
+		}
+
+		/** header and column table of a store with the given block size in rows */
+		void createHeader(uint32_t rowsPerBlock, std::vector<unsigned char>& bytes)
+		{
+			const size_t headerSize = alignUp(sizeof(StoreHeader) + numColumns * sizeof(StoreColumn));
+			bytes.assign(headerSize, 0);
+			StoreColumn* columns = reinterpret_cast<StoreColumn*>(&bytes[sizeof(StoreHeader)]);
+
+			size_t offset = sizeof(BlockHeader);
+			for (int i = 0; i < numColumns; ++i)
+			{
+				std::string name;
+				if (i < firstPointColumn)
+				{
+					name = "pairId";
+					columns[i].type = UInt64;
+				}
+				else if (i < firstStageColumn)
+				{
+					name = std::string(pointNames[(i - firstPointColumn) / 3]) + "." + "xyz"[(i - firstPointColumn) % 3];
+					columns[i].type = Float64;
+				}
+				else
+				{
+					name = stageNames[i - firstStageColumn];
+					columns[i].type = Float32;
+				}
+				strncpy(columns[i].name, name.c_str(), sizeof(columns[i].name) - 1);
+				columns[i].offset = static_cast<uint32_t>(offset);
+				offset = alignUp(offset + valueSize(columns[i].type) * rowsPerBlock);
+			}
+
+			StoreHeader header;
+			header.magic = magic;
+			header.version = version;
+			header.headerSize = static_cast<uint32_t>(headerSize);
+			header.rowsPerBlock = rowsPerBlock;
+			header.columnCount = numColumns;
+			header.blockSize = static_cast<uint32_t>(offset);
+			memcpy(&bytes[0], &header, sizeof(StoreHeader));
+		}
+
+		/** the header of a store, written by this version */
+		const StoreHeader& checkHeader(const unsigned char* data, size_t size, std::vector<unsigned char>& expected)
+		{
+			StoreHeader header;
+			if (size < sizeof(StoreHeader))
+			{
+				throw std::runtime_error("geometry store: too small");
+			}
+			memcpy(&header, data, sizeof(StoreHeader));
+			if (header.magic != magic)
+			{
+				throw std::runtime_error("geometry store: not a geometry store (magic number)");
+			}
+			if (header.rowsPerBlock == 0 || header.rowsPerBlock > (1u << 20))
+			{
+				throw std::runtime_error("geometry store: invalid block size");
+			}
+
+			// same version and columns: the whole header is the same as the one this version writes
+			createHeader(header.rowsPerBlock, expected);
+			if (size < expected.size() || memcmp(data, &expected[0], expected.size()) != 0)
+			{
+				throw std::runtime_error("geometry store: written by another version of the detection");
+			}
+			if ((size - expected.size()) % header.blockSize != 0)
+			{
+				throw std::runtime_error("geometry store: truncated block");
+			}
+			return *reinterpret_cast<const StoreHeader*>(&expected[0]);
+		}
+	}
+
+
+
+	uint64_t pairIdFromName(const std::string& name)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		for (size_t i = 0; i < name.size(); ++i)
+		{
+			hash ^= static_cast<unsigned char>(name[i]);
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+
+
+	GeometryStore::GeometryStore(const std::string& fn, uint32_t rowsPerBlock)
+		: m_Fn(fn)
+		, m_RowsPerBlock(0)
+		, m_BlockSize(0)
+		, m_BlockIndex(0)
+	{
+		// an existing store: continue in its last block if that isn't full yet
+		std::vector<unsigned char> existing;
+		{
+			const MappedFile file(fn);
+			if (file.isOpen())
+			{
+				const StoreHeader& header = checkHeader(file.data(), file.size(), m_Header);
+				m_RowsPerBlock = header.rowsPerBlock;
+				m_BlockSize = header.blockSize;
+				const uint64_t blockCount = (file.size() - header.headerSize) / header.blockSize;
+				if (blockCount > 0)
+				{
+					const unsigned char* last = file.data() + header.headerSize + (blockCount - 1) * header.blockSize;
+					const bool isFull = reinterpret_cast<const BlockHeader*>(last)->rowCount >= m_RowsPerBlock;
+					m_BlockIndex = isFull ? blockCount : blockCount - 1;
+					if (!isFull)
+					{
+						existing.assign(last, last + m_BlockSize);
+					}
+				}
+			}
+		}
+
+		// a new store: only the header
+		if (m_Header.empty())
+		{
+			if (rowsPerBlock == 0)
+			{
+				throw std::runtime_error("geometry store: invalid block size");
+			}
+			createHeader(rowsPerBlock, m_Header);
+			m_RowsPerBlock = rowsPerBlock;
+			m_BlockSize = reinterpret_cast<const StoreHeader*>(&m_Header[0])->blockSize;
+
+			std::ofstream f(fn.c_str(), std::ios::binary | std::ios::trunc);
+			f.write(reinterpret_cast<const char*>(&m_Header[0]), m_Header.size());
+			if (!f)
+			{
+				throw std::runtime_error("couldn't write the geometry store");
+			}
+		}
+
+		m_Block.assign(m_BlockSize, 0);
+		if (!existing.empty())
+		{
+			m_Block.swap(existing);
+		}
+	}
+
+
+
+	GeometryStore::~GeometryStore()
+	{
+		try
+		{
+			flush();
+		}
+		catch (...)
+		{
+		}
+	}
+
+
+
+	void GeometryStore::append(const GeometryStoreRow& row)
+	{
+		const StoreColumn* columns = reinterpret_cast<const StoreColumn*>(&m_Header[sizeof(StoreHeader)]);
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		BlockHeader* blockHeader = reinterpret_cast<BlockHeader*>(&m_Block[0]);
+		const uint32_t r = blockHeader->rowCount;
+
+		// each value goes into its own column
+		memcpy(&m_Block[columns[0].offset + r * sizeof(uint64_t)], &row.pairId, sizeof(uint64_t));
+		for (int p = 0; p < GeometryFormat::NumPoints; ++p)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				memcpy(&m_Block[columns[firstPointColumn + 3 * p + c].offset + r * sizeof(double)], &row.geometry.points[p][c], sizeof(double));
+			}
+		}
+		for (int s = 0; s < GeometryStoreRow::NumStages; ++s)
+		{
+			memcpy(&m_Block[columns[firstStageColumn + s].offset + r * sizeof(float)], &row.stageMs[s], sizeof(float));
+		}
+		blockHeader->rowCount = r + 1;
+
+		// a full block is written by this thread, the other threads already continue with the next one
+		if (r + 1 == m_RowsPerBlock)
+		{
+			std::vector<unsigned char> full(m_BlockSize, 0);
+			full.swap(m_Block);
+			const uint64_t index = m_BlockIndex++;
+			lock.unlock();
+			try
+			{
+				writeBlock(index, full);
+			}
+			catch (...)
+			{
+				// the rows of the block were already accepted, they are kept for the next flush
+				lock.lock();
+				m_FailedBlocks.push_back(std::make_pair(index, std::vector<unsigned char>()));
+				m_FailedBlocks.back().second.swap(full);
+				throw;
+			}
+		}
+	}
+
+
+
+	void GeometryStore::flush()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		while (!m_FailedBlocks.empty())
+		{
+			writeBlock(m_FailedBlocks.back().first, m_FailedBlocks.back().second);
+			m_FailedBlocks.pop_back();
+		}
+		if (reinterpret_cast<const BlockHeader*>(&m_Block[0])->rowCount > 0)
+		{
+			writeBlock(m_BlockIndex, m_Block);
+		}
+	}
+
+
+
+	void GeometryStore::writeBlock(uint64_t index, const std::vector<unsigned char>& block)
+	{
+		// the blocks may be written out of order, each one has its fixed position
+		std::lock_guard<std::mutex> lock(m_FileMutex);
+		std::fstream f(m_Fn.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		f.seekp(static_cast<std::streamoff>(m_Header.size() + index * m_BlockSize));
+		f.write(reinterpret_cast<const char*>(&block[0]), block.size());
+		if (!f)
+		{
+			throw std::runtime_error("couldn't write the geometry store");
+		}
+	}
+
+
+
+	GeometryStoreReader::GeometryStoreReader(const std::string& fn)
+		: m_File(new MappedFile(fn))
+		, m_BlockCount(0)
+		, m_RowCount(0)
+	{
+		if (!m_File->isOpen())
+		{
+			throw std::runtime_error("couldn't open the geometry store");
+		}
+		std::vector<unsigned char> expected;
+		const StoreHeader& h = checkHeader(m_File->data(), m_File->size(), expected);
+		m_BlockCount = (m_File->size() - h.headerSize) / h.blockSize;
+		for (size_t i = 0; i < m_BlockCount; ++i)
+		{
+			const uint32_t rows = reinterpret_cast<const BlockHeader*>(block(i))->rowCount;
+			m_RowCount += rows < h.rowsPerBlock ? rows : h.rowsPerBlock;
+		}
+	}
+
+
+
+	GeometryStoreReader::~GeometryStoreReader()
+	{
+	}
+
+
+
+	const StoreHeader& GeometryStoreReader::header() const
+	{
+		return *reinterpret_cast<const StoreHeader*>(m_File->data());
+	}
+
+
+
+	const StoreColumn& GeometryStoreReader::column(int col) const
+	{
+		return reinterpret_cast<const StoreColumn*>(m_File->data() + sizeof(StoreHeader))[col];
+	}
+
+
+
+	const unsigned char* GeometryStoreReader::block(size_t idx) const
+	{
+		return m_File->data() + header().headerSize + idx * header().blockSize;
+	}
+
+
+
+	int GeometryStoreReader::columnCount() const
+	{
+		return static_cast<int>(header().columnCount);
+	}
+
+
+
+	std::string GeometryStoreReader::columnName(int col) const
+	{
+		const StoreColumn& c = column(col);
+		return std::string(c.name, strnlen(c.name, sizeof(c.name)));
+	}
+
+
+
+	int GeometryStoreReader::findColumn(const std::string& name) const
+	{
+		for (int i = 0; i < columnCount(); ++i)
+		{
+			if (columnName(i) == name)
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+
+
+	void GeometryStoreReader::readColumn(int col, std::vector<double>& values) const
+	{
+		values.clear();
+		values.reserve(m_RowCount);
+		const StoreColumn& c = column(col);
+		for (size_t b = 0; b < m_BlockCount; ++b)
+		{
+			const unsigned char* data = block(b);
+			const uint32_t rows = std::min(reinterpret_cast<const BlockHeader*>(data)->rowCount, header().rowsPerBlock);
+			data += c.offset;
+			for (uint32_t r = 0; r < rows; ++r)
+			{
+				if (c.type == Float64)
+				{
+					double v;
+					memcpy(&v, data + r * sizeof(double), sizeof(double));
+					values.push_back(v);
+				}
+				else if (c.type == Float32)
+				{
+					float v;
+					memcpy(&v, data + r * sizeof(float), sizeof(float));
+					values.push_back(v);
+				}
+				else
+				{
+					uint64_t v;
+					memcpy(&v, data + r * sizeof(uint64_t), sizeof(uint64_t));
+					values.push_back(static_cast<double>(v));
+				}
+			}
+		}
+	}
+
+
+
+	void GeometryStoreReader::readPairIds(std::vector<uint64_t>& ids) const
+	{
+		ids.clear();
+		ids.reserve(m_RowCount);
+		const StoreColumn& c = column(0);
+		for (size_t b = 0; b < m_BlockCount; ++b)
+		{
+			const unsigned char* data = block(b);
+			const uint32_t rows = std::min(reinterpret_cast<const BlockHeader*>(data)->rowCount, header().rowsPerBlock);
+			const size_t first = ids.size();
+			ids.resize(first + rows);
+			memcpy(&ids[first], data + c.offset, rows * sizeof(uint64_t));
+		}
+	}
+}
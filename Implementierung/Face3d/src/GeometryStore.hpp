@@ -0,0 +1,154 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include "GeometryFormat.hpp"
+
+/*
+Append-only columnar file of the geometries of a batch run (<out>/faceGeometry.col), one row per image pair.
+The rows are grouped into blocks of a fixed number of rows, inside a block each column is stored contiguously (PAX layout):
+
+	StoreHeader         magic, version, rows per block, number of columns, size of a block
+	StoreColumn[n]      name, type and offset inside the block of each column
+	block[0..]          BlockHeader (number of rows) followed by the values of each column
+
+All blocks have the same size, only the last one may be partly filled. New rows go into the last block, nothing else
+is ever overwritten. A tool which needs a single coordinate of all faces maps the file and reads only that column
+of each block instead of opening one file per pair. All values are in the native byte order (little endian on the
+supported targets, x86).
+*/
+
+namespace Face3D
+{
+	class MappedFile;
+
+	namespace GeometryStoreFormat
+	{
+		const uint32_t magic = 0x53473346; ///< "F3GS"
+		const uint32_t version = 1; ///< increase on every change of the layout or of the columns
+
+		enum ColumnType { UInt64, Float64, Float32 };
+
+		struct StoreHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t headerSize; ///< bytes before the first block, incl. the column table
+			uint32_t rowsPerBlock;
+			uint32_t columnCount;
+			uint32_t blockSize; ///< bytes from one block to the next
+		};
+
+		struct StoreColumn
+		{
+			char name[24]; ///< e.g. "leftEye.x", zero terminated
+			uint32_t type; ///< ColumnType
+			uint32_t offset; ///< of the first value inside the block
+		};
+
+		struct BlockHeader
+		{
+			uint32_t rowCount;
+			uint32_t reserved[15]; ///< 0, the columns start at a cache line
+		};
+
+		static_assert(sizeof(StoreHeader) == 24 && sizeof(StoreColumn) == 32 && sizeof(BlockHeader) == 64, "the layout of the store depends on the compiler");
+	}
+
+	/** one pair of a batch run */
+	struct GeometryStoreRow
+	{
+		/** the stages of the batch pipeline, each has its own column */
+		enum Stage { Decode, Detect, Encode, NumStages };
+
+		GeometryStoreRow() : pairId(0) { stageMs[Decode] = stageMs[Detect] = stageMs[Encode] = 0.0f; }
+
+		uint64_t pairId; ///< see pairIdFromName()
+		GeometryRecord geometry;
+		float stageMs[NumStages]; ///< time of each stage in ms
+	};
+
+	/** \brief  id of an image pair: FNV-1a (64 bit) of its name, the same in every run */
+	uint64_t pairIdFromName(const std::string& name);
+
+	/** appends rows to the store, from any number of threads */
+	class GeometryStore
+	{
+	public:
+		/** \brief  open the store, it gets created if it doesn't exist yet. throws if it has another layout
+		* \param fn the file
+		* \param rowsPerBlock only for a new file: rows of a block
+		*/
+		GeometryStore(const std::string& fn, uint32_t rowsPerBlock = 4096);
+
+		/** writes the rows which are still in memory */
+		~GeometryStore();
+
+		/** \brief  add a row, a block is written as soon as it is full. thread safe.
+		* throws if the full block couldn't be written, its rows (incl. this one) stay in memory and are written again by flush()
+		*/
+		void append(const GeometryStoreRow& row);
+
+		/** \brief  write the blocks which failed before and the partly filled last block, the following rows are added to it.
+		* thread safe. throws if a block couldn't be written, nothing gets lost then and flush() can be called again.
+		*/
+		void flush();
+
+	private:
+		GeometryStore(const GeometryStore&);
+		GeometryStore& operator=(const GeometryStore&);
+
+		void writeBlock(uint64_t index, const std::vector<unsigned char>& block);
+
+		std::string m_Fn;
+		std::vector<unsigned char> m_Header; ///< header and column table
+		uint32_t m_RowsPerBlock;
+		uint32_t m_BlockSize;
+
+		std::mutex m_Mutex; ///< the current block
+		std::vector<unsigned char> m_Block; ///< the last block, as it is stored in the file
+		uint64_t m_BlockIndex;
+		std::vector<std::pair<uint64_t, std::vector<unsigned char> > > m_FailedBlocks; ///< full blocks whose write failed, with their index
+
+		std::mutex m_FileMutex; ///< the file, full blocks are written without holding m_Mutex
+	};
+
+	/** reads single columns of a store, through a memory map */
+	class GeometryStoreReader
+	{
+	public:
+		/** \brief  map the store, throws if it is missing or has another layout */
+		explicit GeometryStoreReader(const std::string& fn);
+		~GeometryStoreReader();
+
+		size_t rowCount() const { return m_RowCount; }
+		int columnCount() const;
+		std::string columnName(int col) const;
+
+		/** \brief  index of the column, -1 if there is none of this name */
+		int findColumn(const std::string& name) const;
+
+		/** \brief  all values of a column, converted to double. only the blocks of this column are read. */
+		void readColumn(int col, std::vector<double>& values) const;
+
+		/** \brief  the pair ids of all rows */
+		void readPairIds(std::vector<uint64_t>& ids) const;
+
+	private:
+		GeometryStoreReader(const GeometryStoreReader&);
+		GeometryStoreReader& operator=(const GeometryStoreReader&);
+
+		const GeometryStoreFormat::StoreHeader& header() const;
+		const GeometryStoreFormat::StoreColumn& column(int col) const;
+		const unsigned char* block(size_t idx) const;
+
+		std::unique_ptr<MappedFile> m_File;
+		size_t m_BlockCount;
+		size_t m_RowCount;
+	};
+}
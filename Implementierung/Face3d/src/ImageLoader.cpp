@@ -0,0 +1,241 @@
+#include "ImageLoader.hpp"
+#include "FileUtils.hpp"
+#include <algorithm>
+#if CV_MAJOR_VERSION < 3
+#include <cstdio>
+#include <csetjmp>
+extern "C"
+{
+#include <jpeglib.h>
+}
+#endif
+
+
+namespace Face3D
+{
+#if CV_MAJOR_VERSION < 3
+	namespace
+	{
+		/** libjpeg calls exit() on errors by default, this jumps back into decodeJpegScaled() instead */
+		struct JpegErrorManager
+		{
+			jpeg_error_mgr pub;
+			jmp_buf jump;
+		};
+
+		void onJpegError(j_common_ptr cinfo)
+		{
+			longjmp(reinterpret_cast<JpegErrorManager*>(cinfo->err)->jump, 1);
+		}
+
+		void onJpegMessage(j_common_ptr)
+		{
+		}
+
+		// source manager for a buffer in memory, the libjpeg of OpenCV 2.4 has no jpeg_mem_src
+		void initSource(j_decompress_ptr)
+		{
+		}
+
+		boolean fillInputBuffer(j_decompress_ptr cinfo)
+		{
+			// the data is truncated: an end of image marker lets libjpeg finish with a warning, like the decoder of OpenCV
+			static const JOCTET endOfImage[2] = { 0xFF, JPEG_EOI };
+			cinfo->src->next_input_byte = endOfImage;
+			cinfo->src->bytes_in_buffer = 2;
+			return TRUE;
+		}
+
+		void skipInputData(j_decompress_ptr cinfo, long numBytes)
+		{
+			if (numBytes <= 0)
+			{
+				return;
+			}
+			if (static_cast<size_t>(numBytes) > cinfo->src->bytes_in_buffer)
+			{
+				fillInputBuffer(cinfo);
+				return;
+			}
+			cinfo->src->next_input_byte += numBytes;
+			cinfo->src->bytes_in_buffer -= numBytes;
+		}
+
+		void termSource(j_decompress_ptr)
+		{
+		}
+
+		/** \brief  decode a JPEG file scaled by 1/reduction in the DCT domain.
+		* no C++ objects with destructors live in this function, the error handler jumps out of libjpeg with longjmp.
+		* \param img the BGR image, allocated by this function
+		* \return false if the file couldn't be decoded (e.g. CMYK, which libjpeg doesn't convert)
+		*/
+		bool decodeJpegScaled(const std::vector<uchar>& bytes, int reduction, cv::Mat& img)
+		{
+			jpeg_decompress_struct cinfo;
+			JpegErrorManager err;
+			jpeg_source_mgr src;
+			cinfo.err = jpeg_std_error(&err.pub);
+			err.pub.error_exit = onJpegError;
+			err.pub.output_message = onJpegMessage;
+			if (setjmp(err.jump))
+			{
+				jpeg_destroy_decompress(&cinfo);
+				return false;
+			}
+
+			jpeg_create_decompress(&cinfo);
+			src.next_input_byte = &bytes[0];
+			src.bytes_in_buffer = bytes.size();
+			src.init_source = initSource;
+			src.fill_input_buffer = fillInputBuffer;
+			src.skip_input_data = skipInputData;
+			src.resync_to_restart = jpeg_resync_to_restart;
+			src.term_source = termSource;
+			cinfo.src = &src;
+			jpeg_read_header(&cinfo, TRUE);
+
+			const bool isGray = cinfo.jpeg_color_space == JCS_GRAYSCALE;
+			if (!isGray && cinfo.num_components != 3)
+			{
+				jpeg_destroy_decompress(&cinfo);
+				return false;
+			}
+			cinfo.out_color_space = isGray ? JCS_GRAYSCALE : JCS_RGB;
+			cinfo.scale_num = 1;
+			cinfo.scale_denom = reduction;
+			jpeg_start_decompress(&cinfo);
+
+			img.create(cinfo.output_height, cinfo.output_width, isGray ? CV_8UC1 : CV_8UC3);
+			while (cinfo.output_scanline < cinfo.output_height)
+			{
+				JSAMPROW row = img.ptr<uchar>(cinfo.output_scanline);
+				jpeg_read_scanlines(&cinfo, &row, 1);
+			}
+			jpeg_finish_decompress(&cinfo);
+			jpeg_destroy_decompress(&cinfo);
+
+			cv::cvtColor(img, img, isGray ? CV_GRAY2BGR : CV_RGB2BGR);
+			return true;
+		}
+	}
+#endif
+
+
+
+	bool readJpegSize(const std::vector<uchar>& bytes, cv::Size& size)
+	{
+		const size_t n = bytes.size();
+		if (n < 4 || bytes[0] != 0xFF || bytes[1] != 0xD8)
+		{
+			return false;
+		}
+
+		// walk along the segments until the start of frame, which holds the size
+		size_t pos = 2;
+		while (pos + 4 <= n)
+		{
+			if (bytes[pos] != 0xFF)
+			{
+				return false;
+			}
+			const uchar marker = bytes[pos + 1];
+			if (marker == 0xFF)
+			{
+				// fill byte
+				++pos;
+				continue;
+			}
+			if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+			{
+				// markers without a segment
+				pos += 2;
+				continue;
+			}
+
+			const size_t length = (bytes[pos + 2] << 8) | bytes[pos + 3];
+			const bool isStartOfFrame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+			if (isStartOfFrame)
+			{
+				if (pos + 9 > n)
+				{
+					return false;
+				}
+				size.height = (bytes[pos + 5] << 8) | bytes[pos + 6];
+				size.width = (bytes[pos + 7] << 8) | bytes[pos + 8];
+				return size.width > 0 && size.height > 0;
+			}
+			if (marker == 0xDA || length < 2)
+			{
+				// start of scan: the image data follows, there was no start of frame
+				return false;
+			}
+			pos += 2 + length;
+		}
+		return false;
+	}
+
+
+
+	int chooseDecodeReduction(const cv::Size& size, int minSize)
+	{
+		if (minSize <= 0)
+		{
+			return 1;
+		}
+
+		const int smallerSide = std::min(size.width, size.height);
+		int reduction = 8;
+		while (reduction > 1 && smallerSide / reduction < minSize)
+		{
+			reduction /= 2;
+		}
+		return reduction;
+	}
+
+
+
+	cv::Mat decodeImageReduced(const std::vector<uchar>& bytes, int reduction)
+	{
+		if (bytes.empty())
+		{
+			return cv::Mat();
+		}
+
+		// the reduction only takes place in the DCT domain of JPEG files, other formats would be decoded fully and then resized
+		int flags = cv::IMREAD_COLOR;
+		cv::Size size;
+		if (readJpegSize(bytes, size) && reduction >= 2)
+		{
+			reduction = reduction >= 8 ? 8 : reduction >= 4 ? 4 : 2;
+#if CV_MAJOR_VERSION >= 3
+			flags = reduction == 8 ? cv::IMREAD_REDUCED_COLOR_8 : reduction == 4 ? cv::IMREAD_REDUCED_COLOR_4 : cv::IMREAD_REDUCED_COLOR_2;
+#else
+			cv::Mat img;
+			if (decodeJpegScaled(bytes, reduction, img))
+			{
+				return img;
+			}
+#endif
+		}
+		return cv::imdecode(bytes, flags);
+	}
+
+
+
+	cv::Mat decodeImage(const std::vector<uchar>& bytes, int minSize)
+	{
+		cv::Size size;
+		const int reduction = readJpegSize(bytes, size) ? chooseDecodeReduction(size, minSize) : 1;
+		return decodeImageReduced(bytes, reduction);
+	}
+
+
+
+	cv::Mat loadImage(const std::string& fn, int minSize)
+	{
+		std::vector<uchar> bytes;
+		readFile(fn, bytes);
+		return decodeImage(bytes, minSize);
+	}
+}
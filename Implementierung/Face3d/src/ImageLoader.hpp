@@ -0,0 +1,49 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+/*
+Loading of the input images. Camera photos are much bigger than what the pipeline needs, a JPEG can be decoded
+at 1/2, 1/4 or 1/8 of its size directly in the DCT domain, which skips most of the decoding work.
+OpenCV 3 and newer do this themselves (IMREAD_REDUCED_COLOR_*), with OpenCV 2.4 the JPEG files are decoded with libjpeg
+(scale_num/scale_denom), which OpenCV links anyway.
+*/
+
+namespace Face3D
+{
+	/** smallest side of the decoded images by default: the detection uses 320x320, the 256x256 textures are cut out of the face region.
+	* the sample images in input/ are 640x640 and therefore decoded in full resolution, camera photos (from 1280 pixels) are reduced.
+	* --benchmark measures all reductions of an image, also the ones this default doesn't choose */
+	const int defaultMinDecodeSize = 640;
+
+	/** \brief  read the image size from the header of a JPEG file, without decoding it
+	* \param bytes the JPEG file
+	* \param size width and height of the image
+	* \return false if this is not a JPEG file or the header is broken
+	*/
+	bool readJpegSize(const std::vector<uchar>& bytes, cv::Size& size);
+
+	/** \brief  the biggest reduction (1, 2, 4 or 8) which keeps the smaller side of the image at least minSize
+	* \param size size of the image
+	* \param minSize min. size of the smaller side, 0 for no reduction
+	*/
+	int chooseDecodeReduction(const cv::Size& size, int minSize);
+
+	/** \brief  decode a color image, reduced as much as possible
+	* \param bytes the encoded image
+	* \param minSize min. size of the smaller side of the decoded image, 0 for full resolution
+	* \return the BGR image, empty if it couldn't be decoded
+	*/
+	cv::Mat decodeImage(const std::vector<uchar>& bytes, int minSize);
+
+	/** \brief  decode a color image at a fixed reduction, e.g. for benchmarks
+	* \param bytes the encoded image
+	* \param reduction 1, 2, 4 or 8. JPEG only, other formats are always decoded in full resolution
+	*/
+	cv::Mat decodeImageReduced(const std::vector<uchar>& bytes, int reduction);
+
+	/** \brief  read and decode a color image, same as decodeImage() */
+	cv::Mat loadImage(const std::string& fn, int minSize);
+}
@@ -0,0 +1,95 @@
+#include "MappedFile.hpp"
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+namespace Face3D
+{
+#ifdef _WIN32
+	MappedFile::MappedFile(const std::string& fn)
+		: m_Data(0)
+		, m_Size(0)
+		, m_File(INVALID_HANDLE_VALUE)
+		, m_Mapping(0)
+	{
+		m_File = CreateFileA(fn.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+		if (m_File == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+
+		// an empty file can't be mapped, it is treated as a missing one
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0)
+		{
+			return;
+		}
+
+		m_Mapping = CreateFileMappingA(m_File, 0, PAGE_READONLY, 0, 0, 0);
+		if (!m_Mapping)
+		{
+			return;
+		}
+		m_Data = static_cast<const unsigned char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+		m_Size = m_Data ? static_cast<size_t>(size.QuadPart) : 0;
+	}
+
+
+
+	MappedFile::~MappedFile()
+	{
+		if (m_Data)
+		{
+			UnmapViewOfFile(m_Data);
+		}
+		if (m_Mapping)
+		{
+			CloseHandle(m_Mapping);
+		}
+		if (m_File != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_File);
+		}
+	}
+#else
+	MappedFile::MappedFile(const std::string& fn)
+		: m_Data(0)
+		, m_Size(0)
+	{
+		const int fd = open(fn.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			return;
+		}
+
+		// the mapping stays valid after closing the descriptor, an empty file can't be mapped
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			void* data = mmap(0, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED)
+			{
+				m_Data = static_cast<const unsigned char*>(data);
+				m_Size = static_cast<size_t>(st.st_size);
+			}
+		}
+		close(fd);
+	}
+
+
+
+	MappedFile::~MappedFile()
+	{
+		if (m_Data)
+		{
+			munmap(const_cast<unsigned char*>(m_Data), m_Size);
+		}
+	}
+#endif
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace Face3D
+{
+	/** read-only memory map of a whole file. the content is only read from disk when it is accessed and is never copied. */
+	class MappedFile
+	{
+	public:
+		/** \brief  map the file
+		* \param fn the file, it must not be changed while it is mapped
+		*/
+		explicit MappedFile(const std::string& fn);
+		~MappedFile();
+
+		/** false if the file couldn't be opened or is empty */
+		bool isOpen() const { return m_Data != 0; }
+
+		const unsigned char* data() const { return m_Data; }
+		size_t size() const { return m_Size; }
+
+	private:
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+
+		const unsigned char* m_Data;
+		size_t m_Size;
+#ifdef _WIN32
+		void* m_File; ///< HANDLE of the file
+		void* m_Mapping; ///< HANDLE of the file mapping
+#endif
+	};
+}
@@ -12,13 +12,58 @@ namespace Face3D
 	Model::Model(const ModelInfo& modelInfo)
 	:m_ModelInfo(modelInfo)
 	{
-		m_FaceCoords.fromFile("ipc/faceGeometry.txt");
+		m_FaceCoords.fromFile(modelInfo.geometry);
 		load(modelInfo.modelPath);
 		m_TextureFrontID = Texture::Instance().loadFromImage(modelInfo.textureFront);
 		m_TextureSideID = Texture::Instance().loadFromImage(modelInfo.textureSide);
 	}
 
 
+	Model::Model(const ModelInfo& modelInfo, const FaceData& face)
+	:m_ModelInfo(modelInfo)
+	{
+		// no files: the points are taken as they are and the textures are uploaded from the memory of the detection
+		m_FaceCoords.fromRecord(face.geometry);
+		load(modelInfo.modelPath);
+		m_TextureFrontID = Texture::Instance().loadFromMemory("detection/front", face.textureFront);
+		m_TextureSideID = Texture::Instance().loadFromMemory("detection/side", face.textureSide);
+	}
+
+
+	void Model::setGeometry(const GeometryRecord& record)
+	{
+		// only the deformation is done again, the import, the shader and the textures stay
+		m_FaceCoords.fromRecord(record);
+		std::vector<Vertex> vertices;
+		for (size_t i = 0; i < m_pMeshes->size(); ++i)
+		{
+			Mesh& mesh = (*m_pMeshes)[i];
+			deformVertices(mesh.getGenericVertices(), vertices);
+			mesh.updateVertices(vertices);
+		}
+	}
+
+
+	void Model::setTextures(const FaceData& face)
+	{
+		m_TextureFrontID = Texture::Instance().loadFromMemory("detection/front", face.textureFront);
+		m_TextureSideID = Texture::Instance().loadFromMemory("detection/side", face.textureSide);
+	}
+
+
+	void Model::reloadTextureFiles(bool front, bool side)
+	{
+		if (front)
+		{
+			m_TextureFrontID = Texture::Instance().reloadFromImage(m_ModelInfo.textureFront);
+		}
+		if (side)
+		{
+			m_TextureSideID = Texture::Instance().reloadFromImage(m_ModelInfo.textureSide);
+		}
+	}
+
+
 	// load model if not yet cached
 	void Model::load(const std::string& path)
 	{
@@ -213,39 +258,22 @@ namespace Face3D
 
 	Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene, std::string name)
 	{		
-		calcScalingFactors();
-
-		// calc positions of important vertices in resized model
-		glm::vec4 posLeftEye = glm::vec4(m_ModelInfo.leftEye,1.0f)*m_fx;
-
-				
-		std::vector<Vertex> vertices;
+		std::vector<Vertex> genericVertices;
 		std::vector<GLuint> indices;
 
-
-/*		if (mesh->mNumVertices > 0) {
-			maxY = mesh->mVertices[0].y;
-			minY = mesh->mVertices[0].y;
-		}
-		*/
 		for (GLuint a = 0; a < mesh->mNumVertices; a++)
 		{
 			Vertex vertex;
 			
-			// Position
-			glm::vec3 originalPos(mesh->mVertices[a].x, mesh->mVertices[a].y, mesh->mVertices[a].z);
-			vertex.position = glm::vec4(moveGenericVertex(originalPos), 1.0f);
-
-			// Find min and maxY;
-		//	maxY = maxY < vertex.position.y ? vertex.position.y : maxY;
-		//	minY = minY > vertex.position.y ? vertex.position.y : minY;
+			// Position, as in the generic model
+			vertex.position = glm::vec4(mesh->mVertices[a].x, mesh->mVertices[a].y, mesh->mVertices[a].z, 1.0f);
 
 			// Normal		
 			vertex.normal = glm::vec4(mesh->mNormals[a].x, mesh->mNormals[a].y, mesh->mNormals[a].z,1.0f);
 			
 
 			// save new vertex
-			vertices.push_back(vertex);
+			genericVertices.push_back(vertex);
 		}
 
 		// Collect all the indices from the faces of the mesh 
@@ -258,6 +286,23 @@ namespace Face3D
 			}
 		}
 
+		std::vector<Vertex> vertices;
+		deformVertices(genericVertices, vertices);
+		return Mesh(genericVertices, vertices, indices);
+	}
+
+
+	void Model::deformVertices(const std::vector<Vertex>& genericVertices, std::vector<Vertex>& vertices)
+	{
+		calcScalingFactors();
+
+		vertices.resize(genericVertices.size());
+		for (size_t i = 0; i < genericVertices.size(); i++)
+		{
+			vertices[i].position = glm::vec4(moveGenericVertex(glm::vec3(genericVertices[i].position)), 1.0f);
+			vertices[i].normal = genericVertices[i].normal;
+		}
+
 		// y is scaled upside down
 		float maxY = 2.62698f * m_fy; // taken from blender
 		float minY = -1.50149f * m_fy; // taken from blender
@@ -284,9 +329,6 @@ namespace Face3D
 
 
 		}
-	
-
-		return Mesh(vertices, indices);
 	}
 
 
@@ -334,8 +376,9 @@ namespace Face3D
 	}
 
 
-	Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices)
-	:m_Vertices(vertices)
+	Mesh::Mesh(const std::vector<Vertex>& genericVertices, const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices)
+	:m_GenericVertices(genericVertices)
+	,m_Vertices(vertices)
 	,m_Indices(indices)
 	{			
 		setup();
@@ -355,7 +398,7 @@ namespace Face3D
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EboID);
 
 		// Fill them with data
-		glBufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(Vertex), &m_Vertices[0], GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(Vertex), &m_Vertices[0], GL_DYNAMIC_DRAW); // updated by updateVertices()
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Indices.size() * sizeof(GLuint), &m_Indices[0], GL_STATIC_DRAW);
 
 		// Set vertex attribute pointers
@@ -371,6 +414,17 @@ namespace Face3D
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
 
+	void Mesh::updateVertices(const std::vector<Vertex>& vertices)
+	{
+		assert(vertices.size() == m_Vertices.size());
+		m_Vertices = vertices;
+
+		// same size: the buffer is overwritten in place, the VAO stays valid
+		glBindBuffer(GL_ARRAY_BUFFER, m_VboID);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, m_Vertices.size() * sizeof(Vertex), &m_Vertices[0]);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
 	void Mesh::render()
 	{
 		// Retrieve saved data / Bind VAO
@@ -11,6 +11,7 @@
 #include <assimp/postprocess.h> // Post processing flags
 // Helpers
 #include "FaceCoordinates3d.hpp"
+#include "FaceData.hpp"
 #include "GLHeader.hpp"
 
 
@@ -36,10 +37,17 @@ namespace Face3D
 	class Mesh
 	{
 	public:
-		Mesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+		/** the generic vertices are kept to deform the mesh again for another face, vertices are the deformed ones */
+		Mesh(const std::vector<Vertex>& genericVertices, const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
 		void render();		
 
+		const std::vector<Vertex>& getGenericVertices() const { return m_GenericVertices; }
+
+		/** replace the content of the vertex buffer, same number of vertices. the indices don't change. */
+		void updateVertices(const std::vector<Vertex>& vertices);
+
 	private:
+		std::vector<Vertex> m_GenericVertices;
 		std::vector<Vertex> m_Vertices;
 		std::vector<GLuint> m_Indices;
 		GLuint m_VaoID=0, m_VboID=0, m_EboID=0;	
@@ -56,6 +64,7 @@ namespace Face3D
 			struct ModelInfo
 			{
 				std::string modelPath;
+				std::string geometry;
 				std::string textureFront;
 				std::string textureSide;
 
@@ -69,7 +78,21 @@ namespace Face3D
 
 			};
 
+			/** geometry and textures from the ipc files of the detection */
 			Model(const ModelInfo& modelInfo);
+
+			/** geometry and textures of a detection in the same process, the texture files of the model info are not used */
+			Model(const ModelInfo& modelInfo, const FaceData& face);
+
+			/** deform the already loaded generic mesh for another face and update the vertex buffers, nothing is imported again */
+			void setGeometry(const GeometryRecord& record);
+
+			/** upload the textures of another result of the detection in the same or another process (shared memory) */
+			void setTextures(const FaceData& face);
+
+			/** read the texture files of the model info again, e.g. after the detection has written them */
+			void reloadTextureFiles(bool front, bool side);
+
 			void rotate(GLfloat val){ m_RotationAngle = val; }
 			void scale(GLfloat val){ m_ScaleVal = val; }
 			void render();
@@ -107,5 +130,8 @@ namespace Face3D
 
 			/**  move a vrtex of the generic model to its final position according to the face detection */
 			glm::vec3 moveGenericVertex(const glm::vec3& genericVertex);
+
+			/** move all vertices of a generic mesh according to the current face coordinates */
+			void deformVertices(const std::vector<Vertex>& genericVertices, std::vector<Vertex>& vertices);
 		};	
 }
@@ -0,0 +1,148 @@
+#include "PolygonSimplification.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+
+namespace Face3D
+{
+	void PolygonSimplifier::setContour(const std::vector<cv::Point>& contour)
+	{
+		m_Contour = contour;
+		const int n = static_cast<int>(m_Contour.size());
+		m_Importance.assign(n, 0.0);
+		m_SplitOrder.assign(n, n);
+		if (n == 0)
+		{
+			m_Rank.clear();
+			m_Order.clear();
+			return;
+		}
+
+		// Douglas-Peucker on a closed contour starts with two vertices: the first one and the one farthest away from it
+		int farthest = 0;
+		double maxDist = -1.0;
+		for (int i = 0; i < n; ++i)
+		{
+			const cv::Point d = m_Contour[i] - m_Contour[0];
+			const double dist = d.dot(d);
+			if (dist > maxDist)
+			{
+				maxDist = dist;
+				farthest = i;
+			}
+		}
+		m_Importance[0] = DBL_MAX;
+		m_Importance[farthest] = DBL_MAX;
+		m_SplitOrder[0] = 0;
+		m_SplitOrder[farthest] = 1;
+		int numSplits = 2;
+
+		// split the two halves until no vertices are left, each split vertex gets its distance as importance.
+		// the importance is limited by the one of the vertex which created the segment: the vertex can't be in the polygon without it.
+		m_Stack.clear();
+		m_Stack.push_back(Segment(0, farthest, DBL_MAX));
+		m_Stack.push_back(Segment(farthest, n, DBL_MAX));
+		while (!m_Stack.empty())
+		{
+			const Segment seg = m_Stack.back();
+			m_Stack.pop_back();
+			if (seg.last - seg.first < 2)
+			{
+				continue;
+			}
+
+			const cv::Point& a = m_Contour[seg.first];
+			const cv::Point& b = m_Contour[seg.last % n];
+			const cv::Point2d dir(b.x - a.x, b.y - a.y);
+			const double len = std::sqrt(dir.dot(dir));
+
+			int split = seg.first + 1;
+			maxDist = -1.0;
+			for (int i = seg.first + 1; i < seg.last; ++i)
+			{
+				const cv::Point2d d(m_Contour[i].x - a.x, m_Contour[i].y - a.y);
+				const double dist = len > 0.0 ? std::abs(dir.cross(d)) / len : std::sqrt(d.dot(d));
+				if (dist > maxDist)
+				{
+					maxDist = dist;
+					split = i;
+				}
+			}
+
+			const double importance = std::min(maxDist, seg.importance);
+			m_Importance[split] = importance;
+			m_SplitOrder[split] = numSplits++;
+			m_Stack.push_back(Segment(seg.first, split, importance));
+			m_Stack.push_back(Segment(split, seg.last, importance));
+		}
+
+		// the order of importance answers the queries by vertex count. equal importance is sorted by the order of the splits,
+		// so a vertex never comes before the vertex which created its segment: the first k vertices are always a valid polygon
+		m_Order.resize(n);
+		for (int i = 0; i < n; ++i)
+		{
+			m_Order[i] = i;
+		}
+		const std::vector<double>& importance = m_Importance;
+		const std::vector<int>& splitOrder = m_SplitOrder;
+		std::sort(m_Order.begin(), m_Order.end(), [&importance, &splitOrder](int a, int b)
+		{
+			return importance[a] != importance[b] ? importance[a] > importance[b] : splitOrder[a] < splitOrder[b];
+		});
+		m_Rank.resize(n);
+		for (int i = 0; i < n; ++i)
+		{
+			m_Rank[m_Order[i]] = i;
+		}
+	}
+
+
+
+	size_t PolygonSimplifier::countVertices(double tolerance) const
+	{
+		size_t res = 0;
+		for (size_t i = 0; i < m_Importance.size(); ++i)
+		{
+			res += m_Importance[i] > tolerance ? 1 : 0;
+		}
+		return res;
+	}
+
+
+
+	void PolygonSimplifier::simplify(double tolerance, std::vector<cv::Point>& polygon) const
+	{
+		polygon.clear();
+		for (size_t i = 0; i < m_Contour.size(); ++i)
+		{
+			if (m_Importance[i] > tolerance)
+			{
+				polygon.push_back(m_Contour[i]);
+			}
+		}
+	}
+
+
+
+	void PolygonSimplifier::simplifyToCount(size_t count, std::vector<cv::Point>& polygon) const
+	{
+		const int n = static_cast<int>(std::max<size_t>(count, 2));
+		polygon.clear();
+		for (size_t i = 0; i < m_Contour.size(); ++i)
+		{
+			if (m_Rank[i] < n)
+			{
+				polygon.push_back(m_Contour[i]);
+			}
+		}
+	}
+
+
+
+	size_t PolygonSimplifier::capacity() const
+	{
+		return m_Contour.capacity()*sizeof(cv::Point) + m_Importance.capacity()*sizeof(double) + m_Rank.capacity()*sizeof(int) + m_SplitOrder.capacity()*sizeof(int)
+			+ m_Order.capacity()*sizeof(int) + m_Stack.capacity()*sizeof(Segment);
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+/*
+Hierarchical Douglas-Peucker simplification of a closed contour.
+The split steps of Douglas-Peucker are run once down to the last vertex, and each vertex remembers the tolerance up to which
+it is part of the simplified polygon (its importance). Any tolerance or vertex count can then be queried in linear time,
+instead of simplifying the whole contour again for each tolerance.
+*/
+
+namespace Face3D
+{
+	/** simplifies a closed contour to any tolerance or vertex count, after computing the importance of its vertices once */
+	class PolygonSimplifier
+	{
+	public:
+		/** \brief  compute the importance of all vertices of a closed contour, O(n log n) for typical contours
+		* \param contour the contour, e.g. from findContours. it is copied.
+		*/
+		void setContour(const std::vector<cv::Point>& contour);
+
+		/** \brief  number of vertices of the polygon simplified with the given tolerance
+		* \param tolerance max. distance of the contour to the polygon, same as epsilon of approxPolyDP
+		*/
+		size_t countVertices(double tolerance) const;
+
+		/** \brief  simplify with a tolerance: Douglas-Peucker, starting with the first vertex and the vertex farthest away from it
+		* \param tolerance max. distance of the contour to the polygon
+		* \param polygon the resulting vertices in the order of the contour
+		*/
+		void simplify(double tolerance, std::vector<cv::Point>& polygon) const;
+
+		/** \brief  the most important vertices, i.e. the polygon with the smallest tolerance that has at most the given number of vertices
+		* \param count number of vertices, at least 2 (the vertices Douglas-Peucker starts with)
+		* \param polygon the resulting vertices in the order of the contour
+		*/
+		void simplifyToCount(size_t count, std::vector<cv::Point>& polygon) const;
+
+		/** memory reserved by the scratch buffers in bytes, it doesn't grow once the simplifier is warmed up */
+		size_t capacity() const;
+
+	private:
+		/** a part of the contour from first to last (indices, last may be >= size for the part which wraps around) */
+		struct Segment
+		{
+			Segment(int f, int l, double imp) : first(f), last(l), importance(imp){}
+			int first, last;
+			double importance; ///< importance of the vertex which created the segment, the vertices inside can't be more important
+		};
+
+		std::vector<cv::Point> m_Contour;
+		std::vector<double> m_Importance; ///< per vertex: the polygon contains the vertex for all tolerances below this value
+		std::vector<int> m_SplitOrder; ///< per vertex: when Douglas-Peucker selected it
+		std::vector<int> m_Rank; ///< per vertex: position in the order of decreasing importance
+		std::vector<int> m_Order; ///< vertex indices sorted by decreasing importance
+		std::vector<Segment> m_Stack; ///< segments which still have to be split
+	};
+}
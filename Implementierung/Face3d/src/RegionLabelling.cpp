@@ -0,0 +1,292 @@
+#include "RegionLabelling.hpp"
+#include <algorithm>
+
+
+namespace Face3D
+{
+	int RegionLabeller::createLabel()
+	{
+		m_Parent.push_back(static_cast<int>(m_Parent.size()));
+		return m_Parent.back();
+	}
+
+
+
+	int RegionLabeller::findRoot(int label)
+	{
+		int root = label;
+		while (m_Parent[root] != root)
+		{
+			root = m_Parent[root];
+		}
+
+		// path compression
+		while (m_Parent[label] != root)
+		{
+			const int next = m_Parent[label];
+			m_Parent[label] = root;
+			label = next;
+		}
+
+		return root;
+	}
+
+
+
+	int RegionLabeller::unite(int a, int b)
+	{
+		a = findRoot(a);
+		b = findRoot(b);
+		if (a < b)
+		{
+			m_Parent[b] = a;
+			return a;
+		}
+
+		m_Parent[a] = b;
+		return b;
+	}
+
+
+
+	void RegionLabeller::labelRegions(const cv::Mat& binary, cv::Mat& labels, std::vector<RegionInfo>& foreground, std::vector<RegionInfo>& holes)
+	{
+		CV_Assert(binary.type() == CV_8UC1);
+
+		const int width = binary.cols;
+		const int height = binary.rows;
+		labels.create(binary.size(), CV_32S);
+
+		// label 0 is not used
+		m_Parent.assign(1, 0);
+		m_Stats.assign(1, LabelStats(false, 0, 0, 0));
+
+		// the sweep: provisional labels and their statistics
+		for (int y = 0; y < height; ++y)
+		{
+			const uchar* row = binary.ptr<uchar>(y);
+			const uchar* prevRow = y > 0 ? binary.ptr<uchar>(y - 1) : 0;
+			int* labelRow = labels.ptr<int>(y);
+			const int* prevLabelRow = y > 0 ? labels.ptr<int>(y - 1) : 0;
+			const bool borderRow = y == 0 || y == height - 1;
+
+			for (int x = 0; x < width; ++x)
+			{
+				const bool fg = row[x] != 0;
+				int label = 0;
+
+				// west and north neighbour: same class means same region
+				if (x > 0 && (row[x - 1] != 0) == fg)
+				{
+					label = labelRow[x - 1];
+				}
+				if (prevRow && (prevRow[x] != 0) == fg)
+				{
+					label = label ? unite(label, prevLabelRow[x]) : prevLabelRow[x];
+				}
+				else if (prevRow && fg)
+				{
+					// foreground is 8-connected: also check the diagonal neighbours (not needed if north is foreground, it connects them already)
+					if (x > 0 && prevRow[x - 1] != 0)
+					{
+						label = label ? unite(label, prevLabelRow[x - 1]) : prevLabelRow[x - 1];
+					}
+					if (x + 1 < width && prevRow[x + 1] != 0)
+					{
+						label = label ? unite(label, prevLabelRow[x + 1]) : prevLabelRow[x + 1];
+					}
+				}
+
+				// new region: the pixel above (if any) is of the other class, it belongs to the enclosing region
+				if (!label)
+				{
+					label = createLabel();
+					m_Stats.push_back(LabelStats(fg, x, y, prevLabelRow ? prevLabelRow[x] : 0));
+				}
+
+				labelRow[x] = label;
+				LabelStats& s = m_Stats[label];
+				++s.area;
+				s.sumX += x;
+				s.sumY += y;
+				s.minX = x < s.minX ? x : s.minX;
+				s.maxX = x > s.maxX ? x : s.maxX;
+				s.maxY = y;
+				s.touchesBorder = s.touchesBorder || borderRow || x == 0 || x == width - 1;
+			}
+		}
+
+		// merge the statistics of each provisional label into its root
+		for (size_t label = 1; label < m_Parent.size(); ++label)
+		{
+			const int root = findRoot(static_cast<int>(label));
+			if (root == static_cast<int>(label))
+			{
+				continue;
+			}
+
+			const LabelStats& s = m_Stats[label];
+			LabelStats& r = m_Stats[root];
+			r.touchesBorder = r.touchesBorder || s.touchesBorder;
+			r.area += s.area;
+			r.sumX += s.sumX;
+			r.sumY += s.sumY;
+			r.minX = std::min(r.minX, s.minX);
+			r.minY = std::min(r.minY, s.minY);
+			r.maxX = std::max(r.maxX, s.maxX);
+			r.maxY = std::max(r.maxY, s.maxY);
+		}
+
+		// final labels: foreground regions and holes get numbered, the background touching the border becomes 0
+		foreground.clear();
+		holes.clear();
+		m_FinalLabel.assign(m_Parent.size(), 0);
+		for (size_t label = 1; label < m_Parent.size(); ++label)
+		{
+			const int root = findRoot(static_cast<int>(label));
+			if (root != static_cast<int>(label))
+			{
+				m_FinalLabel[label] = m_FinalLabel[root];
+				continue;
+			}
+
+			const LabelStats& s = m_Stats[label];
+			if (!s.isForeground && s.touchesBorder)
+			{
+				continue;
+			}
+
+			// the pixel above was labelled before, the parent is resolved below
+			RegionInfo region;
+			region.parentLabel = s.parentLabel;
+			region.area = s.area;
+			region.cogX = double(s.sumX) / s.area;
+			region.cogY = double(s.sumY) / s.area;
+			region.boundingBox = cv::Rect(s.minX, s.minY, s.maxX - s.minX + 1, s.maxY - s.minY + 1);
+			if (s.isForeground)
+			{
+				region.label = static_cast<int>(foreground.size()) + 1;
+				foreground.push_back(region);
+			}
+			else
+			{
+				region.label = -(static_cast<int>(holes.size()) + 1);
+				holes.push_back(region);
+			}
+			m_FinalLabel[label] = region.label;
+		}
+
+		for (size_t i = 0; i < foreground.size(); ++i)
+		{
+			foreground[i].parentLabel = m_FinalLabel[foreground[i].parentLabel];
+		}
+		for (size_t i = 0; i < holes.size(); ++i)
+		{
+			holes[i].parentLabel = m_FinalLabel[holes[i].parentLabel];
+		}
+
+		// replace the provisional labels
+		for (int y = 0; y < height; ++y)
+		{
+			int* labelRow = labels.ptr<int>(y);
+			for (int x = 0; x < width; ++x)
+			{
+				labelRow[x] = m_FinalLabel[labelRow[x]];
+			}
+		}
+	}
+
+
+
+	void keepBiggestRegions(std::vector<RegionInfo>& regions, size_t k)
+	{
+		k = std::min(k, regions.size());
+		std::partial_sort(regions.begin(), regions.begin() + k, regions.end());
+		regions.resize(k);
+	}
+
+
+
+	void translateRegions(std::vector<RegionInfo>& regions, const cv::Point& offset)
+	{
+		for (size_t i = 0; i < regions.size(); ++i)
+		{
+			regions[i].cogX += offset.x;
+			regions[i].cogY += offset.y;
+			regions[i].boundingBox.x += offset.x;
+			regions[i].boundingBox.y += offset.y;
+		}
+	}
+
+
+
+	void RegionLabeller::getRegionMask(const cv::Mat& labels, const RegionInfo& region, const std::vector<RegionInfo>& foreground, const std::vector<RegionInfo>& holes, bool fillHoles, cv::Mat& mask)
+	{
+		CV_Assert(labels.type() == CV_32S && region.label > 0);
+
+		// which regions belong to the mask, indexed by label (foreground) and -label (holes)
+		m_IsInsideFg.assign(foreground.size() + 1, 0);
+		m_IsInsideHole.assign(holes.size() + 1, 0);
+		m_IsInsideFg[region.label] = 1;
+
+		// the holes of the region, the regions inside of those holes, their holes, ... the nesting is usually not deep
+		bool changed = fillHoles;
+		while (changed)
+		{
+			changed = false;
+			for (size_t i = 0; i < holes.size(); ++i)
+			{
+				if (!m_IsInsideHole[-holes[i].label] && m_IsInsideFg[holes[i].parentLabel])
+				{
+					m_IsInsideHole[-holes[i].label] = 1;
+					changed = true;
+				}
+			}
+			for (size_t i = 0; i < foreground.size(); ++i)
+			{
+				if (!m_IsInsideFg[foreground[i].label] && foreground[i].parentLabel < 0 && m_IsInsideHole[-foreground[i].parentLabel])
+				{
+					m_IsInsideFg[foreground[i].label] = 1;
+					changed = true;
+				}
+			}
+		}
+
+		// everything inside is also inside of the bounding box of the region
+		mask.create(labels.size(), CV_8U);
+		mask.setTo(0);
+		const cv::Rect& box = region.boundingBox;
+		for (int y = box.y; y < box.y + box.height; ++y)
+		{
+			const int* labelRow = labels.ptr<int>(y);
+			uchar* maskRow = mask.ptr<uchar>(y);
+			for (int x = box.x; x < box.x + box.width; ++x)
+			{
+				const int label = labelRow[x];
+				maskRow[x] = (label > 0 ? m_IsInsideFg[label] : m_IsInsideHole[-label]) ? 255 : 0;
+			}
+		}
+	}
+
+
+
+	size_t RegionLabeller::capacity() const
+	{
+		return m_Parent.capacity()*sizeof(int) + m_Stats.capacity()*sizeof(LabelStats) + m_FinalLabel.capacity()*sizeof(int)
+			+ m_IsInsideFg.capacity() + m_IsInsideHole.capacity();
+	}
+
+
+
+	void labelRegions(const cv::Mat& binary, cv::Mat& labels, std::vector<RegionInfo>& foreground, std::vector<RegionInfo>& holes)
+	{
+		RegionLabeller().labelRegions(binary, labels, foreground, holes);
+	}
+
+
+
+	void getRegionMask(const cv::Mat& labels, const RegionInfo& region, const std::vector<RegionInfo>& foreground, const std::vector<RegionInfo>& holes, bool fillHoles, cv::Mat& mask)
+	{
+		RegionLabeller().getRegionMask(labels, region, foreground, holes, fillHoles, mask);
+	}
+}
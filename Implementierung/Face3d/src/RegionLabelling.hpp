@@ -0,0 +1,99 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+/*
+Connected component labelling of a binary image with the statistics of each region (area, center of gravity, bounding box).
+Foreground regions are 8-connected, background regions 4-connected (the same topology findContours uses).
+A background region which doesn't touch the image border is a hole, e.g. an eye inside of the face.
+*/
+
+namespace Face3D
+{
+	/** information about a connected region of a binary image */
+	struct RegionInfo
+	{
+		RegionInfo() : label(0), area(0), cogX(0.0), cogY(0.0), parentLabel(0){}
+		int label; ///< value of the region in the label image: foreground regions are > 0, holes < 0
+		int area; ///< number of pixels
+		double cogX, cogY; ///< center of gravity
+		cv::Rect boundingBox;
+		int parentLabel; ///< the enclosing region: a foreground region for a hole, a hole for a foreground region (0 if it is not inside a hole)
+
+		/** sort by area, biggest first */
+		bool operator<(const RegionInfo& other) const
+		{
+			return area > other.area;
+		}
+	};
+
+	/** labelling with its own scratch memory: when it is kept, labelling further images of the same size allocates nothing */
+	class RegionLabeller
+	{
+	public:
+		/** same as the free function labelRegions() */
+		void labelRegions(const cv::Mat& binary, cv::Mat& labels, std::vector<RegionInfo>& foreground, std::vector<RegionInfo>& holes);
+
+		/** same as the free function getRegionMask() */
+		void getRegionMask(const cv::Mat& labels, const RegionInfo& region, const std::vector<RegionInfo>& foreground, const std::vector<RegionInfo>& holes, bool fillHoles, cv::Mat& mask);
+
+		/** memory reserved by the scratch buffers in bytes, it doesn't grow once the labeller is warmed up */
+		size_t capacity() const;
+
+	private:
+		/** statistics of a provisional label, merged into the final regions after the sweep */
+		struct LabelStats
+		{
+			LabelStats(bool fg, int firstX, int firstY, int parent)
+				: isForeground(fg), touchesBorder(false), area(0), sumX(0), sumY(0), minX(firstX), minY(firstY), maxX(firstX), maxY(firstY), parentLabel(parent){}
+
+			bool isForeground;
+			bool touchesBorder;
+			int area;
+			long long sumX, sumY;
+			int minX, minY, maxX, maxY;
+			int parentLabel; ///< provisional label of the pixel above the first pixel, which belongs to the enclosing region
+		};
+
+		/** union-find over the provisional labels. the root of a set is always its smallest label, i.e. the label created first */
+		int createLabel();
+		int findRoot(int label);
+		int unite(int a, int b);
+
+		std::vector<int> m_Parent; ///< union-find forest of the provisional labels
+		std::vector<LabelStats> m_Stats; ///< statistics of the provisional labels
+		std::vector<int> m_FinalLabel; ///< provisional label -> final label
+		std::vector<uchar> m_IsInsideFg, m_IsInsideHole; ///< regions which belong to a mask
+	};
+
+	/** \brief  label the regions of a binary image and collect the statistics of all regions in a single sweep over the image
+	* \param binary 8 bit binary image, everything != 0 is foreground
+	* \param labels resulting label image (32 bit): 1..n for the foreground regions, -1..-m for the holes, 0 for the background around the regions
+	* \param foreground the foreground regions, foreground[i] has the label i+1
+	* \param holes the holes, holes[i] has the label -(i+1)
+	*/
+	void labelRegions(const cv::Mat& binary, cv::Mat& labels, std::vector<RegionInfo>& foreground, std::vector<RegionInfo>& holes);
+
+	/** \brief  keep only the k biggest regions, sorted by area (biggest first). the other regions are not sorted at all.
+	* \param regions the regions, shrinks to at most k elements
+	* \param k number of regions to keep
+	*/
+	void keepBiggestRegions(std::vector<RegionInfo>& regions, size_t k);
+
+	/** \brief  move the regions, e.g. from the coordinates of a region of interest to the coordinates of the whole image
+	* \param regions the regions
+	* \param offset added to the center of gravity and the bounding box
+	*/
+	void translateRegions(std::vector<RegionInfo>& regions, const cv::Point& offset);
+
+	/** \brief  binary mask (255) of a foreground region
+	* \param labels label image from labelRegions()
+	* \param region the foreground region
+	* \param foreground all foreground regions from labelRegions()
+	* \param holes all holes from labelRegions()
+	* \param fillHoles also set the holes of the region and everything inside of them (same as drawing the filled outer contour)
+	* \param mask resulting 8 bit mask, same size as the label image
+	*/
+	void getRegionMask(const cv::Mat& labels, const RegionInfo& region, const std::vector<RegionInfo>& foreground, const std::vector<RegionInfo>& holes, bool fillHoles, cv::Mat& mask);
+}
@@ -0,0 +1,249 @@
+#include "ResultCache.hpp"
+#include "FileUtils.hpp"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+
+
+namespace Face3D
+{
+	namespace
+	{
+		/** increase when the detection changes its results, old entries then don't match anymore */
+		const int cacheVersion = 2;
+
+		const uint64 fnvOffsetBasis = 14695981039346656037ULL;
+		const uint64 fnvPrime = 1099511628211ULL;
+
+		/** FNV-1a, continues the given hash */
+		uint64 fnv1a(uint64 hash, const uchar* data, size_t size)
+		{
+			for (size_t i = 0; i < size; ++i)
+			{
+				hash ^= data[i];
+				hash *= fnvPrime;
+			}
+			return hash;
+		}
+
+		uint64 fnv1a(uint64 hash, const std::string& str)
+		{
+			return fnv1a(hash, reinterpret_cast<const uchar*>(str.data()), str.size());
+		}
+
+		std::string keyToString(uint64 key)
+		{
+			std::stringstream ss;
+			ss << std::hex << std::setw(16) << std::setfill('0') << key;
+			return ss.str();
+		}
+
+		/** copy a file, returns its size (0 if it couldn't be copied). the destination is replaced as a whole, the viewer may be reading it */
+		size_t copyFile(const std::string& src, const std::string& dst)
+		{
+			const std::string tmp = dst + ".tmp";
+			std::vector<uchar> bytes;
+			if (!readFile(src, bytes) || !writeFile(tmp, bytes) || !replaceFile(tmp, dst))
+			{
+				std::remove(tmp.c_str());
+				return 0;
+			}
+			return bytes.size();
+		}
+	}
+
+
+
+	ResultCache::ResultCache(const std::string& dir, size_t maxBytes)
+		: m_Dir(dir)
+		, m_MaxBytes(maxBytes)
+		, m_Hits(0)
+		, m_Misses(0)
+		, m_UseCounter(0)
+	{
+		createDirectory(m_Dir);
+		loadIndex();
+	}
+
+
+
+	uint64 ResultCache::computeKey(const std::vector<uchar>& front, const std::vector<uchar>& side, const Detection::DetectFaceOptions& options, int decodeSize)
+	{
+		// the sizes separate the two images: moving bytes from one image to the other gives another key
+		std::stringstream params;
+		params << cacheVersion << ";" << front.size() << ";" << side.size() << ";" << options.colorThreshold << ";"
+			<< std::setprecision(17) << options.addTextureTop << ";" << options.addTextureBottom << ";" << options.detectionSize << ";" << options.preprocessing << ";" << decodeSize;
+
+		uint64 hash = fnvOffsetBasis;
+		hash = fnv1a(hash, params.str());
+		hash = fnv1a(hash, front.empty() ? 0 : &front[0], front.size());
+		hash = fnv1a(hash, side.empty() ? 0 : &side[0], side.size());
+		return hash;
+	}
+
+
+
+	bool ResultCache::lookup(uint64 key, const ResultFiles& dst)
+	{
+		std::vector<Entry>::iterator it = m_Entries.begin();
+		while (it != m_Entries.end() && it->key != key)
+		{
+			++it;
+		}
+
+		// a hit needs all files, an entry with missing files (e.g. deleted by hand) is dropped.
+		// the geometry goes last, the viewer reloads the result when it changes
+		bool hit = false;
+		if (it != m_Entries.end())
+		{
+			const ResultFiles src = getEntryFiles(key);
+			hit = copyFile(src.textureFront, dst.textureFront) && copyFile(src.textureSide, dst.textureSide) && copyFile(src.geometry, dst.geometry);
+			if (hit)
+			{
+				it->lastUse = ++m_UseCounter;
+			}
+			else
+			{
+				removeEntryFiles(key);
+				m_Entries.erase(it);
+			}
+		}
+
+		++(hit ? m_Hits : m_Misses);
+		saveIndex();
+		return hit;
+	}
+
+
+
+	void ResultCache::store(uint64 key, const ResultFiles& src)
+	{
+		const ResultFiles dst = getEntryFiles(key);
+		const size_t geometrySize = copyFile(src.geometry, dst.geometry);
+		const size_t frontSize = copyFile(src.textureFront, dst.textureFront);
+		const size_t sideSize = copyFile(src.textureSide, dst.textureSide);
+		if (!geometrySize || !frontSize || !sideSize)
+		{
+			// not cached, but still a valid result. an older entry of this key may have been overwritten partly
+			removeEntryFiles(key);
+			std::vector<Entry>::iterator it = m_Entries.begin();
+			while (it != m_Entries.end() && it->key != key)
+			{
+				++it;
+			}
+			if (it != m_Entries.end())
+			{
+				m_Entries.erase(it);
+				saveIndex();
+			}
+			return;
+		}
+
+		Entry entry;
+		entry.key = key;
+		entry.size = geometrySize + frontSize + sideSize;
+		entry.lastUse = ++m_UseCounter;
+
+		std::vector<Entry>::iterator it = m_Entries.begin();
+		while (it != m_Entries.end() && it->key != key)
+		{
+			++it;
+		}
+		if (it != m_Entries.end())
+		{
+			*it = entry;
+		}
+		else
+		{
+			m_Entries.push_back(entry);
+		}
+
+		evict();
+		saveIndex();
+	}
+
+
+
+	size_t ResultCache::size() const
+	{
+		size_t res = 0;
+		for (size_t i = 0; i < m_Entries.size(); ++i)
+		{
+			res += m_Entries[i].size;
+		}
+		return res;
+	}
+
+
+
+	ResultCache::ResultFiles ResultCache::getEntryFiles(uint64 key) const
+	{
+		const std::string prefix = m_Dir + "/" + keyToString(key);
+		ResultFiles res;
+		res.geometry = prefix + "_faceGeometry.bin";
+		res.textureFront = prefix + "_front.jpg";
+		res.textureSide = prefix + "_side.jpg";
+		return res;
+	}
+
+
+
+	void ResultCache::removeEntryFiles(uint64 key) const
+	{
+		const ResultFiles files = getEntryFiles(key);
+		std::remove(files.geometry.c_str());
+		std::remove(files.textureFront.c_str());
+		std::remove(files.textureSide.c_str());
+	}
+
+
+
+	void ResultCache::evict()
+	{
+		// most recently used first, the ones at the end get removed
+		std::sort(m_Entries.begin(), m_Entries.end(), [](const Entry& a, const Entry& b){ return a.lastUse > b.lastUse; });
+
+		size_t total = size();
+		while (total > m_MaxBytes && !m_Entries.empty())
+		{
+			const Entry& oldest = m_Entries.back();
+			removeEntryFiles(oldest.key);
+			total -= oldest.size;
+			m_Entries.pop_back();
+		}
+	}
+
+
+
+	void ResultCache::loadIndex()
+	{
+		// first line: counters, then one line per entry: key (hex), size, last use
+		std::ifstream f((m_Dir + "/index.txt").c_str());
+		if (!(f >> m_Hits >> m_Misses >> m_UseCounter))
+		{
+			m_Hits = m_Misses = 0;
+			m_UseCounter = 0;
+			return;
+		}
+
+		Entry entry;
+		while (f >> std::hex >> entry.key >> std::dec >> entry.size >> entry.lastUse)
+		{
+			m_Entries.push_back(entry);
+		}
+	}
+
+
+
+	void ResultCache::saveIndex() const
+	{
+		std::ofstream f((m_Dir + "/index.txt").c_str());
+		f << m_Hits << " " << m_Misses << " " << m_UseCounter << "\n";
+		for (size_t i = 0; i < m_Entries.size(); ++i)
+		{
+			f << keyToString(m_Entries[i].key) << " " << m_Entries[i].size << " " << m_Entries[i].lastUse << "\n";
+		}
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include "Detection.hpp"
+
+/*
+On-disk cache of detection results. The key is a hash of the bytes of both input images and of all detection parameters,
+so a pair which was already processed with the same parameters skips the detection (and even decoding the images).
+An entry consists of the files the detection writes: the serialized face geometry and both textures.
+The index file keeps the size and the last use of each entry (least recently used entries get evicted) and the hit/miss counters.
+The cache is meant to be used by one process at a time.
+*/
+
+namespace Face3D
+{
+	/** on-disk cache of detection results, bounded in size */
+	class ResultCache
+	{
+	public:
+		/** the files of a result: serialized face geometry, front and side texture */
+		struct ResultFiles
+		{
+			std::string geometry;
+			std::string textureFront;
+			std::string textureSide;
+		};
+
+		/** \brief  open the cache, the directory gets created if it doesn't exist
+		* \param dir directory of the cache
+		* \param maxBytes max. size of all entries, least recently used entries get evicted when it is exceeded
+		*/
+		ResultCache(const std::string& dir, size_t maxBytes);
+
+		/** \brief  key of a detection: FNV-1a hash of both input files and of the parameters
+		* \param front bytes of the (encoded) front image
+		* \param side bytes of the (encoded) side image
+		* \param options detection parameters, all of them which change the result are part of the key
+		* \param decodeSize min. size the images are decoded with, see decodeImage()
+		*/
+		static uint64 computeKey(const std::vector<uchar>& front, const std::vector<uchar>& side, const Detection::DetectFaceOptions& options, int decodeSize);
+
+		/** \brief  look up a result and copy its files to the given destination. counts a hit or a miss.
+		* \param key key from computeKey()
+		* \param dst where the files of the result go
+		* \return true on a hit
+		*/
+		bool lookup(uint64 key, const ResultFiles& dst);
+
+		/** \brief  add the files of a result to the cache and evict old entries if the cache gets too big
+		* \param key key from computeKey()
+		* \param src the files written by the detection
+		*/
+		void store(uint64 key, const ResultFiles& src);
+
+		int hits() const { return m_Hits; }
+		int misses() const { return m_Misses; }
+
+		/** size of all entries in bytes */
+		size_t size() const;
+
+	private:
+		struct Entry
+		{
+			uint64 key;
+			size_t size; ///< size of the files in bytes
+			uint64 lastUse; ///< value of the use counter at the last lookup or store
+		};
+
+		/** file names of an entry */
+		ResultFiles getEntryFiles(uint64 key) const;
+
+		/** delete the files of an entry, also if only some of them exist */
+		void removeEntryFiles(uint64 key) const;
+
+		/** remove least recently used entries until the size is ok */
+		void evict();
+
+		void loadIndex();
+		void saveIndex() const;
+
+		std::string m_Dir;
+		size_t m_MaxBytes;
+		std::vector<Entry> m_Entries;
+		int m_Hits, m_Misses;
+		uint64 m_UseCounter; ///< increases with each lookup and store, orders the entries by their last use
+	};
+}
@@ -0,0 +1,413 @@
+#include "ResultChannel.hpp"
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+
+namespace Face3D
+{
+	namespace
+	{
+		const uint32_t channelMagic = 0x48433346; // "F3CH"
+		const uint32_t channelVersion = 1;
+
+		/** slots and pixels start at multiples of a cache line */
+		size_t alignUp(size_t n)
+		{
+			return (n + 63) & ~static_cast<size_t>(63);
+		}
+	}
+
+
+
+	/** at the start of the shared memory, written once by the writer */
+	struct ResultChannel::ChannelHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t slotCount;
+		uint32_t slotSize; ///< bytes from one slot to the next, incl. the pixels
+		uint32_t maxTextureBytes;
+		std::atomic<uint32_t> published; ///< number of results published so far, the newest is in slot (published-1) % slotCount
+	};
+
+
+
+	/** at the start of each slot, followed by the pixels of the front and the side texture (packed rows) */
+	struct ResultChannel::SlotHeader
+	{
+		std::atomic<uint32_t> sequence; ///< odd while the slot is written
+		uint32_t reserved;
+		int32_t frontWidth, frontHeight;
+		int32_t sideWidth, sideHeight;
+		GeometryRecord geometry;
+	};
+
+
+
+	ResultChannel::ResultChannel(const std::string& name, Mode mode, int slotCount, size_t maxTextureBytes)
+		: m_Name(name)
+		, m_IsWriter(mode == Create)
+		, m_Memory(0)
+		, m_Size(0)
+#ifdef _WIN32
+		, m_Mapping(0)
+		, m_Event(0)
+#endif
+	{
+		if (m_IsWriter)
+		{
+			if (slotCount < 1 || maxTextureBytes == 0)
+			{
+				throw std::runtime_error("result channel: invalid size");
+			}
+			const size_t slotSize = alignUp(sizeof(SlotHeader)) + 2 * alignUp(maxTextureBytes);
+			map(alignUp(sizeof(ChannelHeader)) + slotCount * slotSize);
+
+			ChannelHeader* h = header();
+			h->slotCount = slotCount;
+			h->slotSize = static_cast<uint32_t>(slotSize);
+			h->maxTextureBytes = static_cast<uint32_t>(maxTextureBytes);
+			h->published.store(0);
+			for (int i = 0; i < slotCount; ++i)
+			{
+				slot(i)->sequence.store(0);
+			}
+
+			// readers check the magic number last, so they never see a half initialized header
+			h->version = channelVersion;
+			std::atomic_thread_fence(std::memory_order_release);
+			h->magic = channelMagic;
+		}
+		else
+		{
+			map(0);
+			const ChannelHeader* h = header();
+			if (m_Size < sizeof(ChannelHeader) || h->magic != channelMagic || h->version != channelVersion
+				|| m_Size < alignUp(sizeof(ChannelHeader)) + static_cast<size_t>(h->slotCount) * h->slotSize)
+			{
+				unmap();
+				throw std::runtime_error("result channel: created by another version of the detection");
+			}
+		}
+	}
+
+
+
+	ResultChannel::~ResultChannel()
+	{
+		unmap();
+	}
+
+
+
+	ResultChannel::SlotHeader* ResultChannel::slot(uint32_t idx) const
+	{
+		return reinterpret_cast<SlotHeader*>(m_Memory + alignUp(sizeof(ChannelHeader)) + static_cast<size_t>(idx) * header()->slotSize);
+	}
+
+
+
+	unsigned char* ResultChannel::slotPixels(uint32_t idx) const
+	{
+		return reinterpret_cast<unsigned char*>(slot(idx)) + alignUp(sizeof(SlotHeader));
+	}
+
+
+
+	void ResultChannel::publish(const FaceData& face)
+	{
+		if (!m_IsWriter)
+		{
+			throw std::runtime_error("result channel: only the writer can publish");
+		}
+
+		ChannelHeader* h = header();
+		const size_t frontBytes = static_cast<size_t>(face.textureFront.width) * face.textureFront.height * 3;
+		const size_t sideBytes = static_cast<size_t>(face.textureSide.width) * face.textureSide.height * 3;
+		if (frontBytes > h->maxTextureBytes || sideBytes > h->maxTextureBytes)
+		{
+			throw std::runtime_error("result channel: texture too large");
+		}
+
+		// only this process writes, the relaxed load is enough
+		const uint32_t n = h->published.load(std::memory_order_relaxed);
+		const uint32_t idx = n % h->slotCount;
+		SlotHeader* s = slot(idx);
+
+		// odd: readers which took this slot earlier see that it is overwritten
+		const uint32_t seq = s->sequence.load(std::memory_order_relaxed);
+		s->sequence.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		s->geometry = face.geometry;
+		s->frontWidth = face.textureFront.width;
+		s->frontHeight = face.textureFront.height;
+		s->sideWidth = face.textureSide.width;
+		s->sideHeight = face.textureSide.height;
+
+		// one copy of the rows, the viewer uploads them from here
+		unsigned char* dst = slotPixels(idx);
+		const ImageView* images[2] = { &face.textureFront, &face.textureSide };
+		for (int i = 0; i < 2; ++i)
+		{
+			const ImageView& img = *images[i];
+			const size_t rowBytes = static_cast<size_t>(img.width) * 3;
+			for (int y = 0; y < img.height; ++y)
+			{
+				memcpy(dst + y * rowBytes, img.data + y * img.step, rowBytes);
+			}
+			dst += alignUp(h->maxTextureBytes);
+		}
+
+		s->sequence.store(seq + 2, std::memory_order_release);
+		h->published.store(n + 1, std::memory_order_release);
+		notify();
+	}
+
+
+
+	bool ResultChannel::latest(FaceData& face, Token& token) const
+	{
+		const ChannelHeader* h = header();
+		const uint32_t published = h->published.load(std::memory_order_acquire);
+		if (published == 0)
+		{
+			return false;
+		}
+
+		token.published = published;
+		token.slot = (published - 1) % h->slotCount;
+		const SlotHeader* s = slot(token.slot);
+		token.sequence = s->sequence.load(std::memory_order_acquire);
+
+		// the sizes are read without a lock: while the writer changes them, they can be anything. images which would reach
+		// beyond the slot are rejected here, the sequence check below only tells afterwards that they were torn
+		const int32_t sizes[4] = { s->frontWidth, s->frontHeight, s->sideWidth, s->sideHeight };
+		for (int i = 0; i < 4; i += 2)
+		{
+			if (sizes[i] < 0 || sizes[i + 1] < 0 || static_cast<uint64_t>(sizes[i]) * static_cast<uint64_t>(sizes[i + 1]) * 3 > h->maxTextureBytes)
+			{
+				return false;
+			}
+		}
+
+		face.geometry = s->geometry;
+		const unsigned char* pixels = slotPixels(token.slot);
+		face.textureFront = ImageView(pixels, sizes[0], sizes[1], static_cast<size_t>(sizes[0]) * 3);
+		face.textureSide = ImageView(pixels + alignUp(h->maxTextureBytes), sizes[2], sizes[3], static_cast<size_t>(sizes[2]) * 3);
+
+		// the writer went around the whole ring while the header was read
+		return (token.sequence & 1) == 0 && isUnchanged(token);
+	}
+
+
+
+	bool ResultChannel::isUnchanged(const Token& token) const
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return slot(token.slot)->sequence.load(std::memory_order_relaxed) == token.sequence;
+	}
+
+
+
+#ifdef _WIN32
+	void ResultChannel::map(size_t size)
+	{
+		const std::string mappingName = "Local\\Face3d_" + m_Name;
+		const std::string eventName = mappingName + "_event";
+		if (size > 0)
+		{
+			const unsigned long long size64 = size;
+			m_Mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64), mappingName.c_str());
+			m_Event = CreateEventA(0, FALSE, FALSE, eventName.c_str());
+		}
+		else
+		{
+			m_Mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, mappingName.c_str());
+			m_Event = OpenEventA(SYNCHRONIZE, FALSE, eventName.c_str());
+		}
+		if (!m_Mapping || !m_Event)
+		{
+			unmap();
+			throw std::runtime_error("result channel: couldn't open the shared memory");
+		}
+
+		m_Memory = static_cast<unsigned char*>(MapViewOfFile(m_Mapping, size > 0 ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size));
+		MEMORY_BASIC_INFORMATION info;
+		if (!m_Memory || !VirtualQuery(m_Memory, &info, sizeof(info)))
+		{
+			unmap();
+			throw std::runtime_error("result channel: couldn't map the shared memory");
+		}
+		m_Size = size > 0 ? size : info.RegionSize;
+	}
+
+
+
+	void ResultChannel::unmap()
+	{
+		if (m_Memory)
+		{
+			UnmapViewOfFile(m_Memory);
+		}
+		if (m_Mapping)
+		{
+			CloseHandle(m_Mapping);
+		}
+		if (m_Event)
+		{
+			CloseHandle(m_Event);
+		}
+		m_Memory = 0;
+		m_Mapping = 0;
+		m_Event = 0;
+	}
+
+
+
+	void ResultChannel::notify()
+	{
+		// auto reset event: wakes one waiting viewer, the others see the counter on their next timeout
+		SetEvent(m_Event);
+	}
+
+
+
+	uint32_t ResultChannel::wait(uint32_t published, int timeoutMs) const
+	{
+		const uint32_t current = header()->published.load(std::memory_order_acquire);
+		if (current != published)
+		{
+			return current;
+		}
+		WaitForSingleObject(m_Event, timeoutMs);
+		return header()->published.load(std::memory_order_acquire);
+	}
+#else
+	void ResultChannel::map(size_t size)
+	{
+		const std::string shmName = "/face3d_" + m_Name;
+		int fd = -1;
+		if (size > 0)
+		{
+			// a channel left over by a crashed detection is replaced
+			shm_unlink(shmName.c_str());
+			fd = shm_open(shmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+			if (fd >= 0 && ftruncate(fd, static_cast<off_t>(size)) != 0)
+			{
+				close(fd);
+				fd = -1;
+			}
+		}
+		else
+		{
+			fd = shm_open(shmName.c_str(), O_RDONLY, 0);
+			struct stat st;
+			if (fd >= 0 && fstat(fd, &st) == 0)
+			{
+				size = static_cast<size_t>(st.st_size);
+			}
+		}
+		if (fd < 0 || size == 0)
+		{
+			if (fd >= 0)
+			{
+				close(fd);
+			}
+			throw std::runtime_error("result channel: couldn't open the shared memory");
+		}
+
+		// the mapping stays valid after closing the descriptor
+		void* memory = mmap(0, size, m_IsWriter ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (memory == MAP_FAILED)
+		{
+			throw std::runtime_error("result channel: couldn't map the shared memory");
+		}
+		m_Memory = static_cast<unsigned char*>(memory);
+		m_Size = size;
+	}
+
+
+
+	void ResultChannel::unmap()
+	{
+		if (m_Memory)
+		{
+			munmap(m_Memory, m_Size);
+			if (m_IsWriter)
+			{
+				shm_unlink(("/face3d_" + m_Name).c_str());
+			}
+		}
+		m_Memory = 0;
+		m_Size = 0;
+	}
+
+
+
+#ifdef __linux__
+	void ResultChannel::notify()
+	{
+		// the counter itself is the futex, all waiting viewers wake up
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&header()->published), FUTEX_WAKE, 0x7fffffff, 0, 0, 0);
+	}
+
+
+
+	uint32_t ResultChannel::wait(uint32_t published, int timeoutMs) const
+	{
+		uint32_t* word = reinterpret_cast<uint32_t*>(&header()->published);
+		struct timespec timeout;
+		timeout.tv_sec = timeoutMs / 1000;
+		timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+
+		// sleeps only if the counter still has the given value, a result published before is never missed
+		const uint32_t current = header()->published.load(std::memory_order_acquire);
+		if (current == published)
+		{
+			syscall(SYS_futex, word, FUTEX_WAIT, published, &timeout, 0, 0);
+		}
+		return header()->published.load(std::memory_order_acquire);
+	}
+#else
+	void ResultChannel::notify()
+	{
+	}
+
+
+
+	uint32_t ResultChannel::wait(uint32_t published, int timeoutMs) const
+	{
+		// no futex: poll the counter
+		struct timespec pause;
+		pause.tv_sec = 0;
+		pause.tv_nsec = 1000000L;
+		for (int ms = 0; ms < timeoutMs; ++ms)
+		{
+			const uint32_t current = header()->published.load(std::memory_order_acquire);
+			if (current != published)
+			{
+				return current;
+			}
+			nanosleep(&pause, 0);
+		}
+		return header()->published.load(std::memory_order_acquire);
+	}
+#endif
+#endif
+}
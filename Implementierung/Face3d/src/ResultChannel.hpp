@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include "FaceData.hpp"
+
+/*
+Shared memory channel from the detection to the viewer, for the case that both run as separate processes, e.g. a live capture:
+a ring of fixed-size slots, each holding the geometry record and the raw BGR pixels of both textures. The detection publishes each
+result into the next slot, the viewer takes the newest one and uploads the textures directly from the shared memory.
+Nothing is written to disk. A new result is signalled with a futex (Linux) or a named event (Windows), other systems poll.
+
+Each slot has a sequence number which is odd while the slot is written. A reader remembers it and checks afterwards whether the slot
+was overwritten in the meantime (only possible if the writer went once around the whole ring).
+*/
+
+namespace Face3D
+{
+	/** one end of the channel: the writer (detection) creates it, the readers (viewer) open it */
+	class ResultChannel
+	{
+	public:
+		/** a slot as seen by a reader, to check later whether it has been overwritten */
+		struct Token
+		{
+			Token() : slot(0), sequence(0), published(0){}
+			uint32_t slot;
+			uint32_t sequence;
+			uint32_t published; ///< number of the result (1 for the first one)
+		};
+
+		enum Mode
+		{
+			Create, ///< the writer: create the channel, an existing one of the same name is replaced
+			Open ///< a reader: open an existing channel, throws if there is none or it was created by another version
+		};
+
+		/** \brief  create or open the channel
+		* \param name name of the channel, without path
+		* \param mode writer or reader
+		* \param slotCount writer only: number of slots of the ring
+		* \param maxTextureBytes writer only: max. size of a texture (width*height*3), larger textures are rejected by publish
+		*/
+		ResultChannel(const std::string& name, Mode mode, int slotCount = 4, size_t maxTextureBytes = 2048 * 2048 * 3);
+
+		~ResultChannel();
+
+		/** \brief  writer: copy the result into the next slot and notify the readers
+		* \param face the result, e.g. Detection::DetectFaceResult::toFaceData()
+		*/
+		void publish(const FaceData& face);
+
+		/** \brief  reader: the newest result, the images point into the shared memory
+		* \param face the result, valid as long as the channel is open and the slot isn't overwritten
+		* \param token to check later with isUnchanged()
+		* \return false if nothing has been published yet or the newest slot is being overwritten
+		*/
+		bool latest(FaceData& face, Token& token) const;
+
+		/** \brief  reader: false if the slot has been (or is being) overwritten since latest() returned it */
+		bool isUnchanged(const Token& token) const;
+
+		/** \brief  reader: wait until more than the given number of results have been published
+		* \param published number of results seen so far, e.g. Token::published
+		* \param timeoutMs max. time to wait
+		* \return the number of results published so far
+		*/
+		uint32_t wait(uint32_t published, int timeoutMs) const;
+
+	private:
+		struct ChannelHeader;
+		struct SlotHeader;
+
+		ResultChannel(const ResultChannel&);
+		ResultChannel& operator=(const ResultChannel&);
+
+		/** create (size > 0) or open (size 0) the shared memory and map it */
+		void map(size_t size);
+		void unmap();
+
+		/** wake up the readers waiting for a new result */
+		void notify();
+
+		ChannelHeader* header() const { return reinterpret_cast<ChannelHeader*>(m_Memory); }
+		SlotHeader* slot(uint32_t idx) const;
+		unsigned char* slotPixels(uint32_t idx) const;
+
+		std::string m_Name;
+		bool m_IsWriter;
+		unsigned char* m_Memory;
+		size_t m_Size;
+#ifdef _WIN32
+		void* m_Mapping; ///< HANDLE of the file mapping
+		void* m_Event; ///< HANDLE of the event which signals a new result
+#endif
+	};
+}
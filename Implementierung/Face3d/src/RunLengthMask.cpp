@@ -0,0 +1,82 @@
+#include "RunLengthMask.hpp"
+#include <algorithm>
+
+
+namespace Face3D
+{
+	void RunLengthMask::encodeRows(const cv::Mat& binary, int yBegin, int yEnd)
+	{
+		CV_Assert(binary.type() == CV_8UC1);
+		yBegin = std::max(yBegin, 0);
+		yEnd = std::min(yEnd, binary.rows);
+
+		m_Cols = binary.cols;
+		m_Runs.clear();
+		m_RowStart.resize(binary.rows + 1);
+		for (int y = 0; y < binary.rows; ++y)
+		{
+			m_RowStart[y] = static_cast<int>(m_Runs.size());
+			if (y < yBegin || y >= yEnd)
+			{
+				continue;
+			}
+			const uchar* row = binary.ptr<uchar>(y);
+			int x = 0;
+			while (x < m_Cols)
+			{
+				while (x < m_Cols && !row[x])
+				{
+					++x;
+				}
+				const int start = x;
+				while (x < m_Cols && row[x])
+				{
+					++x;
+				}
+				if (x > start)
+				{
+					m_Runs.push_back(Run(start, x));
+				}
+			}
+		}
+		m_RowStart[binary.rows] = static_cast<int>(m_Runs.size());
+	}
+
+
+
+	int RunLengthMask::leftmost(int y, int xBegin, int xEnd) const
+	{
+		for (const Run* run = rowBegin(y); run != rowEnd(y); ++run)
+		{
+			if (run->end > xBegin)
+			{
+				const int x = std::max(run->start, xBegin);
+				return x < xEnd ? x : -1;
+			}
+		}
+		return -1;
+	}
+
+
+
+	int RunLengthMask::rightmost(int y, int xBegin, int xEnd) const
+	{
+		for (const Run* run = rowEnd(y); run != rowBegin(y); --run)
+		{
+			const Run& prev = run[-1];
+			if (prev.start < xEnd)
+			{
+				const int x = std::min(prev.end, xEnd) - 1;
+				return x >= xBegin ? x : -1;
+			}
+		}
+		return -1;
+	}
+
+
+
+	size_t RunLengthMask::capacity() const
+	{
+		return m_Runs.capacity()*sizeof(Run) + m_RowStart.capacity()*sizeof(int);
+	}
+}
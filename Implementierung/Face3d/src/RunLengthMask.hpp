@@ -0,0 +1,61 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+/*
+Run-length encoding of a binary mask: for each row the runs of foreground pixels.
+Queries which walk along a row (leftmost/rightmost foreground pixel) only look at the runs instead of every pixel.
+Only the rows which get queried need to be encoded, the others have no runs.
+*/
+
+namespace Face3D
+{
+	/** binary mask stored as runs of foreground pixels per row. encoding further masks of the same size allocates nothing. */
+	class RunLengthMask
+	{
+	public:
+		/** foreground pixels [start, end) of a row */
+		struct Run
+		{
+			Run(int s, int e) : start(s), end(e){}
+			int start, end;
+		};
+
+		RunLengthMask() : m_Cols(0){}
+
+		/** \brief  encode some rows of a binary mask, the other rows are empty
+		* \param binary 8 bit mask, everything != 0 is foreground
+		* \param yBegin first row to encode
+		* \param yEnd one behind the last row to encode
+		*/
+		void encodeRows(const cv::Mat& binary, int yBegin, int yEnd);
+
+		int rows() const { return m_RowStart.empty() ? 0 : static_cast<int>(m_RowStart.size()) - 1; }
+		int cols() const { return m_Cols; }
+
+		/** the runs of a row, from left to right */
+		const Run* rowBegin(int y) const { return m_Runs.data() + m_RowStart[y]; }
+		const Run* rowEnd(int y) const { return m_Runs.data() + m_RowStart[y + 1]; }
+
+		/** \brief  leftmost foreground pixel of a row inside of [xBegin, xEnd)
+		* \return the x coordinate, -1 if there is no foreground pixel
+		*/
+		int leftmost(int y, int xBegin, int xEnd) const;
+		int leftmost(int y) const { return leftmost(y, 0, m_Cols); }
+
+		/** \brief  rightmost foreground pixel of a row inside of [xBegin, xEnd)
+		* \return the x coordinate, -1 if there is no foreground pixel
+		*/
+		int rightmost(int y, int xBegin, int xEnd) const;
+		int rightmost(int y) const { return rightmost(y, 0, m_Cols); }
+
+		/** memory reserved by the runs in bytes, it doesn't grow once the mask is warmed up */
+		size_t capacity() const;
+
+	private:
+		int m_Cols;
+		std::vector<Run> m_Runs; ///< the runs of all rows
+		std::vector<int> m_RowStart; ///< index of the first run of each row, one more entry than rows
+	};
+}
@@ -0,0 +1,108 @@
+#include "SkinClassifier.hpp"
+
+namespace Face3D
+{
+	// REMARK: the initialization of function local statics is not thread safe with VS2013, so create the instance at startup
+	static SkinClassifier* s_pInstanceAtStartup = &SkinClassifier::Instance();
+
+	SkinClassifier& SkinClassifier::Instance()
+	{
+		static SkinClassifier instance;
+		return instance;
+	}
+
+
+	void SkinClassifier::prepare(const SkinThresholds& thresholds)
+	{
+		getTable(thresholds);
+	}
+
+
+	void SkinClassifier::segment(const cv::Mat& bgr, cv::Mat& mask, const SkinThresholds& thresholds)
+	{
+		CV_Assert(bgr.type() == CV_8UC3);
+		mask.create(bgr.size(), CV_8U);
+
+		// keep a reference, the cache could drop the table in the meantime
+		const std::shared_ptr<const LookupTable> pTable = getTable(thresholds);
+		const unsigned int* table = &(*pTable)[0];
+
+		for (int y = 0; y < bgr.rows; ++y)
+		{
+			const uchar* src = bgr.ptr<uchar>(y);
+			uchar* dst = mask.ptr<uchar>(y);
+			for (int x = 0; x < bgr.cols; ++x, src += 3)
+			{
+				const unsigned int color = ((unsigned int)src[0] << 16) | ((unsigned int)src[1] << 8) | src[2];
+				dst[x] = ((table[color >> 5] >> (color & 31)) & 1) ? 255 : 0;
+			}
+		}
+	}
+
+
+	std::shared_ptr<const SkinClassifier::LookupTable> SkinClassifier::getTable(const SkinThresholds& thresholds)
+	{
+		const unsigned int key = (unsigned int)thresholds.minCr | ((unsigned int)thresholds.maxCr << 8) | ((unsigned int)thresholds.minCb << 16) | ((unsigned int)thresholds.maxCb << 24);
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		// already in cache? then move it to the front
+		for (auto it = m_Cache.begin(); it != m_Cache.end(); ++it)
+		{
+			if (it->first == key)
+			{
+				m_Cache.splice(m_Cache.begin(), m_Cache, it);
+				return m_Cache.front().second;
+			}
+		}
+
+		// create it (while holding the lock, such that concurrent callers don't create the same table twice)
+		m_Cache.push_front(CacheEntry(key, createTable(thresholds)));
+		if (m_Cache.size() > m_MaxCachedTables)
+		{
+			m_Cache.pop_back();
+		}
+
+		return m_Cache.front().second;
+	}
+
+
+	std::shared_ptr<const SkinClassifier::LookupTable> SkinClassifier::createTable(const SkinThresholds& thresholds)
+	{
+		std::shared_ptr<LookupTable> pTable = std::make_shared<LookupTable>((1 << 24) / 32, 0);
+
+		// one row with all (g,r) combinations, only the blue value changes between the rows
+		cv::Mat colors(1, 256 * 256, CV_8UC3);
+		uchar* c = colors.ptr<uchar>(0);
+		for (int g = 0; g < 256; ++g)
+		{
+			for (int r = 0; r < 256; ++r, c += 3)
+			{
+				c[1] = (uchar)g;
+				c[2] = (uchar)r;
+			}
+		}
+
+		cv::Mat mask;
+		for (int b = 0; b < 256; ++b)
+		{
+			c = colors.ptr<uchar>(0);
+			for (int i = 0; i < 256 * 256; ++i, c += 3)
+			{
+				c[0] = (uchar)b;
+			}
+
+			segmentSkin(colors, mask, thresholds);
+
+			// pack the 65536 results of this blue value into bits
+			const uchar* m = mask.ptr<uchar>(0);
+			unsigned int* bits = &(*pTable)[b << 11];
+			for (int i = 0; i < 256 * 256; ++i)
+			{
+				bits[i >> 5] |= (m[i] ? 1u : 0u) << (i & 31);
+			}
+		}
+
+		return pTable;
+	}
+}
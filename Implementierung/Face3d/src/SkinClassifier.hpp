@@ -0,0 +1,50 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include "SkinSegmentation.hpp"
+
+namespace Face3D
+{
+	/** singleton class which classifies skin pixels with a lookup table: one bit for each of the 2^24 BGR colors (2 MB).
+	* the table only depends on the skin thresholds, it is created once for each threshold setting and then cached.
+	* can be used from multiple threads.
+	*/
+	class SkinClassifier
+	{
+	public:
+		static SkinClassifier& Instance();
+
+		/** \brief  binary skin mask (skin=255, else 0) with the same result as segmentSkin(), but a single table lookup per pixel
+		* \param bgr 8 bit BGR image
+		* \param mask resulting 8 bit binary mask, same size as the input image
+		* \param thresholds skin intervals, the lookup table gets created if not yet cached for these thresholds
+		*/
+		void segment(const cv::Mat& bgr, cv::Mat& mask, const SkinThresholds& thresholds);
+
+		/** make sure the lookup table for the thresholds is available, e.g. before a time critical run */
+		void prepare(const SkinThresholds& thresholds);
+
+	private:
+		SkinClassifier(){}
+		SkinClassifier(const SkinClassifier&);
+		SkinClassifier& operator=(const SkinClassifier&);
+
+		/** bit (b<<16 | g<<8 | r) is set if the color is skin */
+		typedef std::vector<unsigned int> LookupTable;
+		typedef std::pair<unsigned int, std::shared_ptr<const LookupTable> > CacheEntry;
+
+		/** get the table from the cache or create it */
+		std::shared_ptr<const LookupTable> getTable(const SkinThresholds& thresholds);
+
+		/** classify all colors with the fused segmentation kernel */
+		static std::shared_ptr<const LookupTable> createTable(const SkinThresholds& thresholds);
+
+		std::mutex m_Mutex;
+		std::list<CacheEntry> m_Cache; ///< most recently used table first
+		const size_t m_MaxCachedTables = 8;
+	};
+}
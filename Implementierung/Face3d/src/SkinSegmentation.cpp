@@ -0,0 +1,353 @@
+#include "SkinSegmentation.hpp"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define FACE3D_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+
+namespace Face3D
+{
+	/*
+	fixed point BGR -> YCrCb conversion, exactly as done by cv::cvtColor for 8 bit images:
+	Y = (R*4899 + G*9617 + B*1868) >> 14
+	Cr = (R-Y)*11682 >> 14 + 128
+	Cb = (B-Y)*9241 >> 14 + 128
+	(all shifts are rounding shifts, the results are saturated to [0..255])
+	*/
+	const int yuvShift = 14;
+	const int coeffR2Y = 4899, coeffG2Y = 9617, coeffB2Y = 1868;
+	const int coeffCr = 11682, coeffCb = 9241;
+	const int roundingDelta = 1 << (yuvShift - 1);
+	const int chromaDelta = (128 << yuvShift) + roundingDelta;
+
+
+	SkinThresholds getSkinThresholds(int offsetCR, int offsetCB)
+	{
+		// REMARK: tweaked the values a bit to get better results
+		SkinThresholds thresholds;
+		thresholds.minCr = cv::saturate_cast<uchar>(143 + offsetCR);
+		thresholds.maxCr = cv::saturate_cast<uchar>(173 + offsetCR);
+		thresholds.minCb = cv::saturate_cast<uchar>(77 + offsetCB);
+		thresholds.maxCb = cv::saturate_cast<uchar>(125 + offsetCB);
+		return thresholds;
+	}
+
+
+	/** scalar version of the color conversion for a single pixel */
+	inline void chroma(int b, int g, int r, uchar& cr, uchar& cb)
+	{
+		const int y = (r*coeffR2Y + g*coeffG2Y + b*coeffB2Y + roundingDelta) >> yuvShift;
+		cr = cv::saturate_cast<uchar>(((r - y)*coeffCr + chromaDelta) >> yuvShift);
+		cb = cv::saturate_cast<uchar>(((b - y)*coeffCb + chromaDelta) >> yuvShift);
+	}
+
+
+	/** scalar version of the threshold for a single pixel */
+	inline uchar isSkin(int cr, int cb, const SkinThresholds& thresholds)
+	{
+		return (cr >= thresholds.minCr && cr <= thresholds.maxCr && cb >= thresholds.minCb && cb <= thresholds.maxCb) ? 255 : 0;
+	}
+
+
+	/** scalar version for a single pixel */
+	inline uchar isSkin(int b, int g, int r, const SkinThresholds& thresholds)
+	{
+		uchar cr, cb;
+		chroma(b, g, r, cr, cb);
+		return isSkin(cr, cb, thresholds);
+	}
+
+
+#ifdef FACE3D_USE_SSE2
+	/** one step of the deinterleaving network: 5 steps split 32 interleaved BGR pixels into the planes b0 b1 g0 g1 r0 r1 */
+	inline void deinterleaveStep(__m128i* v)
+	{
+		const __m128i c0 = _mm_unpacklo_epi8(v[0], v[3]);
+		const __m128i c1 = _mm_unpackhi_epi8(v[0], v[3]);
+		const __m128i c2 = _mm_unpacklo_epi8(v[1], v[4]);
+		const __m128i c3 = _mm_unpackhi_epi8(v[1], v[4]);
+		const __m128i c4 = _mm_unpacklo_epi8(v[2], v[5]);
+		const __m128i c5 = _mm_unpackhi_epi8(v[2], v[5]);
+		v[0] = c0; v[1] = c1; v[2] = c2; v[3] = c3; v[4] = c4; v[5] = c5;
+	}
+
+
+	/** Cr and Cb (32 bit) of 4 pixels, given as 16 bit values in the lower or upper half of the registers */
+	inline void chroma4(__m128i rg, __m128i b1, __m128i r32, __m128i b32, __m128i& cr, __m128i& cb)
+	{
+		const __m128i coeffsRG = _mm_set1_epi32((coeffG2Y << 16) | coeffR2Y);
+		const __m128i coeffsB1 = _mm_set1_epi32((roundingDelta << 16) | coeffB2Y);
+
+		// (r,g) pairs and (b,1) pairs are multiplied and added in a single instruction each
+		const __m128i y = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(rg, coeffsRG), _mm_madd_epi16(b1, coeffsB1)), yuvShift);
+
+		// r-y and b-y are in [-255..255], so the low 16 bits hold the signed value and the coefficients have a zero high part
+		const __m128i delta = _mm_set1_epi32(chromaDelta);
+		cr = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_sub_epi32(r32, y), _mm_set1_epi32(coeffCr)), delta), yuvShift);
+		cb = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_sub_epi32(b32, y), _mm_set1_epi32(coeffCb)), delta), yuvShift);
+	}
+
+
+	/** Cr and Cb (8 bit) of 16 pixels, given as planes */
+	inline void chroma16(__m128i b, __m128i g, __m128i r, __m128i& cr, __m128i& cb)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i one = _mm_set1_epi16(1);
+		__m128i cr16[2], cb16[2];
+
+		for (int half = 0; half < 2; ++half)
+		{
+			// 8 pixels with 16 bit
+			const __m128i b16 = half == 0 ? _mm_unpacklo_epi8(b, zero) : _mm_unpackhi_epi8(b, zero);
+			const __m128i g16 = half == 0 ? _mm_unpacklo_epi8(g, zero) : _mm_unpackhi_epi8(g, zero);
+			const __m128i r16 = half == 0 ? _mm_unpacklo_epi8(r, zero) : _mm_unpackhi_epi8(r, zero);
+
+			__m128i crLo, cbLo, crHi, cbHi;
+			chroma4(_mm_unpacklo_epi16(r16, g16), _mm_unpacklo_epi16(b16, one), _mm_unpacklo_epi16(r16, zero), _mm_unpacklo_epi16(b16, zero), crLo, cbLo);
+			chroma4(_mm_unpackhi_epi16(r16, g16), _mm_unpackhi_epi16(b16, one), _mm_unpackhi_epi16(r16, zero), _mm_unpackhi_epi16(b16, zero), crHi, cbHi);
+
+			cr16[half] = _mm_packs_epi32(crLo, crHi);
+			cb16[half] = _mm_packs_epi32(cbLo, cbHi);
+		}
+
+		// saturate to 8 bit
+		cr = _mm_packus_epi16(cr16[0], cr16[1]);
+		cb = _mm_packus_epi16(cb16[0], cb16[1]);
+	}
+
+
+	/** skin mask of 16 pixels, given as chroma planes */
+	inline __m128i isSkin16(__m128i cr, __m128i cb, const __m128i* bounds)
+	{
+		// unsigned range check: min <= x <=> max(x,min)==x, x <= max <=> min(x,max)==x
+		const __m128i crInside = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(cr, bounds[0]), cr), _mm_cmpeq_epi8(_mm_min_epu8(cr, bounds[1]), cr));
+		const __m128i cbInside = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(cb, bounds[2]), cb), _mm_cmpeq_epi8(_mm_min_epu8(cb, bounds[3]), cb));
+		return _mm_and_si128(crInside, cbInside);
+	}
+
+
+	/** skin mask of 16 pixels, given as planes */
+	inline __m128i skin16(__m128i b, __m128i g, __m128i r, const __m128i* bounds)
+	{
+		__m128i cr, cb;
+		chroma16(b, g, r, cr, cb);
+		return isSkin16(cr, cb, bounds);
+	}
+
+
+	/** the thresholds in SSE2 registers */
+	inline void loadBounds(const SkinThresholds& thresholds, __m128i* bounds)
+	{
+		bounds[0] = _mm_set1_epi8((char)thresholds.minCr);
+		bounds[1] = _mm_set1_epi8((char)thresholds.maxCr);
+		bounds[2] = _mm_set1_epi8((char)thresholds.minCb);
+		bounds[3] = _mm_set1_epi8((char)thresholds.maxCb);
+	}
+
+
+	/** 32 interleaved BGR pixels to planes b0 b1 g0 g1 r0 r1 */
+	inline void loadPlanes(const uchar* bgr, __m128i* v)
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgr + 16 * i));
+		}
+
+		for (int i = 0; i < 5; ++i)
+		{
+			deinterleaveStep(v);
+		}
+	}
+
+
+	/** SSE2 version for a row, processes 32 pixels at once. returns the number of processed pixels. */
+	int segmentSkinRowSSE2(const uchar* bgr, uchar* mask, int width, const SkinThresholds& thresholds)
+	{
+		__m128i bounds[4];
+		loadBounds(thresholds, bounds);
+
+		int x = 0;
+		for (; x + 32 <= width; x += 32)
+		{
+			__m128i v[6];
+			loadPlanes(bgr + 3 * x, v);
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(mask + x), skin16(v[0], v[2], v[4], bounds));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(mask + x + 16), skin16(v[1], v[3], v[5], bounds));
+		}
+
+		return x;
+	}
+
+
+	/** SSE2 version of the color conversion for a row. returns the number of processed pixels. */
+	int extractChromaRowSSE2(const uchar* bgr, uchar* cr, uchar* cb, int width)
+	{
+		int x = 0;
+		for (; x + 32 <= width; x += 32)
+		{
+			__m128i v[6];
+			loadPlanes(bgr + 3 * x, v);
+
+			for (int half = 0; half < 2; ++half)
+			{
+				__m128i cr16, cb16;
+				chroma16(v[half], v[2 + half], v[4 + half], cr16, cb16);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(cr + x + 16 * half), cr16);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(cb + x + 16 * half), cb16);
+			}
+		}
+
+		return x;
+	}
+
+
+	/** SSE2 version of the threshold for a row. returns the number of processed pixels. */
+	int thresholdChromaRowSSE2(const uchar* cr, const uchar* cb, uchar* mask, int width, const SkinThresholds& thresholds)
+	{
+		__m128i bounds[4];
+		loadBounds(thresholds, bounds);
+
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			const __m128i cr16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cr + x));
+			const __m128i cb16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cb + x));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(mask + x), isSkin16(cr16, cb16, bounds));
+		}
+
+		return x;
+	}
+#endif
+
+
+	/** segment a single row */
+	void segmentSkinRow(const uchar* bgr, uchar* mask, int width, const SkinThresholds& thresholds, bool useSSE2)
+	{
+		int x = 0;
+
+#ifdef FACE3D_USE_SSE2
+		if (useSSE2)
+		{
+			x = segmentSkinRowSSE2(bgr, mask, width, thresholds);
+		}
+#endif
+
+		// the rest (or everything if SSE2 is not available)
+		for (; x < width; ++x)
+		{
+			mask[x] = isSkin(bgr[3 * x], bgr[3 * x + 1], bgr[3 * x + 2], thresholds);
+		}
+	}
+
+
+	void segmentSkin(const cv::Mat& bgr, cv::Mat& mask, const SkinThresholds& thresholds)
+	{
+		CV_Assert(bgr.type() == CV_8UC3);
+		mask.create(bgr.size(), CV_8U);
+
+		const bool useSSE2 = cv::checkHardwareSupport(CV_CPU_SSE2);
+		for (int y = 0; y < bgr.rows; ++y)
+		{
+			segmentSkinRow(bgr.ptr<uchar>(y), mask.ptr<uchar>(y), bgr.cols, thresholds, useSSE2);
+		}
+	}
+
+
+	void extractChroma(const cv::Mat& bgr, cv::Mat& cr, cv::Mat& cb)
+	{
+		CV_Assert(bgr.type() == CV_8UC3);
+		cr.create(bgr.size(), CV_8U);
+		cb.create(bgr.size(), CV_8U);
+
+		const bool useSSE2 = cv::checkHardwareSupport(CV_CPU_SSE2);
+		for (int y = 0; y < bgr.rows; ++y)
+		{
+			const uchar* src = bgr.ptr<uchar>(y);
+			uchar* dstCr = cr.ptr<uchar>(y);
+			uchar* dstCb = cb.ptr<uchar>(y);
+			int x = 0;
+
+#ifdef FACE3D_USE_SSE2
+			if (useSSE2)
+			{
+				x = extractChromaRowSSE2(src, dstCr, dstCb, bgr.cols);
+			}
+#endif
+
+			for (; x < bgr.cols; ++x)
+			{
+				chroma(src[3 * x], src[3 * x + 1], src[3 * x + 2], dstCr[x], dstCb[x]);
+			}
+		}
+	}
+
+
+	void extractSmoothedChroma(const cv::Mat& bgr, cv::Mat& cr, cv::Mat& cb, bool halfResolution, cv::Mat& bgrHalf)
+	{
+		if (!halfResolution)
+		{
+			// same kernel as the blur of the BGR image, but two channels instead of three
+			extractChroma(bgr, cr, cb);
+			cv::GaussianBlur(cr, cr, cv::Size(5, 5), 0, 0);
+			cv::GaussianBlur(cb, cb, cv::Size(5, 5), 0, 0);
+			return;
+		}
+
+		// reducing first is cheaper than converting first and gives the same planes (the conversion is linear).
+		// the area interpolation already smooths, the remaining blur is half as wide at half the resolution.
+		cv::resize(bgr, bgrHalf, cv::Size((bgr.cols + 1) / 2, (bgr.rows + 1) / 2), 0, 0, cv::INTER_AREA);
+		extractChroma(bgrHalf, cr, cb);
+		cv::GaussianBlur(cr, cr, cv::Size(3, 3), 0, 0);
+		cv::GaussianBlur(cb, cb, cv::Size(3, 3), 0, 0);
+	}
+
+
+	void thresholdChroma(const cv::Mat& cr, const cv::Mat& cb, cv::Mat& mask, const SkinThresholds& thresholds)
+	{
+		CV_Assert(cr.type() == CV_8U && cb.type() == CV_8U && cr.size() == cb.size());
+		mask.create(cr.size(), CV_8U);
+
+		const bool useSSE2 = cv::checkHardwareSupport(CV_CPU_SSE2);
+		for (int y = 0; y < cr.rows; ++y)
+		{
+			const uchar* srcCr = cr.ptr<uchar>(y);
+			const uchar* srcCb = cb.ptr<uchar>(y);
+			uchar* dst = mask.ptr<uchar>(y);
+			int x = 0;
+
+#ifdef FACE3D_USE_SSE2
+			if (useSSE2)
+			{
+				x = thresholdChromaRowSSE2(srcCr, srcCb, dst, cr.cols, thresholds);
+			}
+#endif
+
+			for (; x < cr.cols; ++x)
+			{
+				dst[x] = isSkin(srcCr[x], srcCb[x], thresholds);
+			}
+		}
+	}
+
+
+	void segmentSkinReference(const cv::Mat& bgr, cv::Mat& mask, const SkinThresholds& thresholds)
+	{
+		// to YCrCb colorspace
+		cv::Mat ycrcb;
+		cv::cvtColor(bgr, ycrcb, CV_BGR2YCrCb);
+
+		// split color channels into seperate grayscale images
+		std::vector<cv::Mat> channels;
+		cv::split(ycrcb, channels);
+
+		// threshold cr and cb color channel
+		cv::Mat crThres, cbThres;
+		cv::inRange(channels[1], cv::Scalar(thresholds.minCr), cv::Scalar(thresholds.maxCr), crThres);
+		cv::inRange(channels[2], cv::Scalar(thresholds.minCb), cv::Scalar(thresholds.maxCb), cbThres);
+
+		// combine result with bitwise and
+		cv::bitwise_and(crThres, cbThres, mask);
+	}
+}
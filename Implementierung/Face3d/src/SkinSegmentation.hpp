@@ -0,0 +1,64 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+/*
+Skin segmentation in the YCrCb colorspace: a pixel is regarded as skin if both its Cr and its Cb value are inside a given interval.
+The Y channel is not needed for the decision, therefore it is never stored.
+*/
+
+namespace Face3D
+{
+	/** intervals of the Cr and Cb channel (YCrCb colorspace, 8 bit) which are regarded as skin */
+	struct SkinThresholds
+	{
+		int minCr, maxCr;
+		int minCb, maxCb;
+	};
+
+	/** \brief  get the skin thresholds, shifted by the offsets selected with the color threshold trackbar
+	* \param offsetCR offset of the Cr interval
+	* \param offsetCB offset of the Cb interval
+	*/
+	SkinThresholds getSkinThresholds(int offsetCR, int offsetCB);
+
+	/** \brief  fused single pass skin segmentation: BGR image -> binary mask (skin=255, else 0) without any intermediate images.
+	* gives exactly the same result as segmentSkinReference(). SSE2 is used if available, otherwise a scalar implementation.
+	* \param bgr 8 bit BGR image
+	* \param mask resulting 8 bit binary mask, same size as the input image
+	* \param thresholds skin intervals
+	*/
+	void segmentSkin(const cv::Mat& bgr, cv::Mat& mask, const SkinThresholds& thresholds);
+
+	/** \brief  convert to the chroma planes Cr and Cb in a single pass (no Y channel), e.g. to cache them when only the thresholds change
+	* \param bgr 8 bit BGR image
+	* \param cr resulting Cr channel
+	* \param cb resulting Cb channel
+	*/
+	void extractChroma(const cv::Mat& bgr, cv::Mat& cr, cv::Mat& cb);
+
+	/** \brief  smoothed chroma planes: convert first, then blur only Cr and Cb instead of all three BGR channels.
+	* the conversion is linear, so apart from rounding this is the same as extractChroma() on the blurred BGR image.
+	* \param bgr 8 bit BGR image, not smoothed
+	* \param cr resulting smoothed Cr channel
+	* \param cb resulting smoothed Cb channel
+	* \param halfResolution the planes get half the width and height (like 4:2:0 chroma subsampling), a quarter of the pixels to convert, blur and threshold
+	* \param bgrHalf scratch buffer for the image at half resolution
+	*/
+	void extractSmoothedChroma(const cv::Mat& bgr, cv::Mat& cr, cv::Mat& cb, bool halfResolution, cv::Mat& bgrHalf);
+
+	/** \brief  binary skin mask (skin=255, else 0) from the chroma planes, gives the same result as segmentSkin() on the original image
+	* \param cr Cr channel from extractChroma()
+	* \param cb Cb channel from extractChroma()
+	* \param mask resulting 8 bit binary mask
+	* \param thresholds skin intervals
+	*/
+	void thresholdChroma(const cv::Mat& cr, const cv::Mat& cb, cv::Mat& mask, const SkinThresholds& thresholds);
+
+	/** \brief  reference implementation with the OpenCV functions: cvtColor, split, inRange and bitwise_and. used for benchmarking and verification.
+	* \param bgr 8 bit BGR image
+	* \param mask resulting 8 bit binary mask, same size as the input image
+	* \param thresholds skin intervals
+	*/
+	void segmentSkinReference(const cv::Mat& bgr, cv::Mat& mask, const SkinThresholds& thresholds);
+}
@@ -0,0 +1,192 @@
+#include "StageTimer.hpp"
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+
+namespace Face3D
+{
+	// REMARK: the initialization of function local statics is not thread safe with VS2013 and the stages are timed from two threads, so create the instance at startup
+	static StageProfiler* s_pProfilerAtStartup = &StageProfiler::Instance();
+
+	StageProfiler& StageProfiler::Instance()
+	{
+		static StageProfiler instance;
+		return instance;
+	}
+
+
+
+	StageProfiler::StageProfiler()
+		: m_Enabled(false)
+		, m_StartTicks(cv::getTickCount())
+	{
+	}
+
+
+
+	void StageProfiler::record(const char* stage, int imgNr, int64 startTicks, int64 endTicks)
+	{
+		const double usPerTick = 1000000.0 / cv::getTickFrequency();
+		const double durationUs = (endTicks - startTicks) * usPerTick;
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stages[stage].add(durationUs);
+
+		if (m_Events.size() < maxEvents)
+		{
+			// the threads get small numbers, the trace viewer shows one row per thread
+			const std::thread::id id = std::this_thread::get_id();
+			std::map<std::thread::id, int>::const_iterator it = m_Threads.find(id);
+			int thread = static_cast<int>(m_Threads.size());
+			if (it != m_Threads.end())
+			{
+				thread = it->second;
+			}
+			else
+			{
+				m_Threads[id] = thread;
+			}
+
+			Event event;
+			event.stage = stage;
+			event.imgNr = imgNr;
+			event.thread = thread;
+			event.startUs = (startTicks - m_StartTicks) * usPerTick;
+			event.durationUs = durationUs;
+			m_Events.push_back(event);
+		}
+	}
+
+
+
+	bool StageProfiler::writeSummary(const std::string& fn) const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		std::ofstream f(fn.c_str());
+		f << std::fixed << std::setprecision(3);
+		f << "{\n  \"stages\": {";
+		for (std::map<std::string, StageStats>::const_iterator it = m_Stages.begin(); it != m_Stages.end(); ++it)
+		{
+			const StageStats& s = it->second;
+			f << (it == m_Stages.begin() ? "\n" : ",\n");
+			f << "    \"" << it->first << "\": {\"count\": " << s.count << ", \"totalMs\": " << s.totalUs / 1000.0
+				<< ", \"meanMs\": " << s.totalUs / s.count / 1000.0 << ", \"minMs\": " << s.minUs / 1000.0 << ", \"maxMs\": " << s.maxUs / 1000.0
+				<< ", \"p50Ms\": " << s.percentile(0.5) / 1000.0 << ", \"p90Ms\": " << s.percentile(0.9) / 1000.0 << ", \"p99Ms\": " << s.percentile(0.99) / 1000.0
+				<< ",\n      \"histogram\": [";
+
+			// only the buckets which are used: upper bound of the bucket and number of measurements
+			bool first = true;
+			for (int b = 0; b < StageStats::numBuckets; ++b)
+			{
+				if (s.buckets[b])
+				{
+					f << (first ? "" : ", ") << "{\"upToMs\": " << StageStats::bucketUpperBound(b) / 1000.0 << ", \"count\": " << s.buckets[b] << "}";
+					first = false;
+				}
+			}
+			f << "]}";
+		}
+		f << "\n  }\n}\n";
+		return !f.fail();
+	}
+
+
+
+	bool StageProfiler::writeChromeTrace(const std::string& fn) const
+	{
+		static const char* imageNames[] = { "front", "side" };
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		std::ofstream f(fn.c_str());
+		f << std::fixed << std::setprecision(3);
+		f << "{\"traceEvents\": [";
+		for (size_t i = 0; i < m_Events.size(); ++i)
+		{
+			// complete events ("X"): start and duration in microseconds
+			const Event& e = m_Events[i];
+			f << (i ? ",\n" : "\n") << "{\"name\": \"" << e.stage << "\", \"cat\": \"detection\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.thread
+				<< ", \"ts\": " << e.startUs << ", \"dur\": " << e.durationUs;
+			if (e.imgNr == 0 || e.imgNr == 1)
+			{
+				f << ", \"args\": {\"image\": \"" << imageNames[e.imgNr] << "\"}";
+			}
+			f << "}";
+		}
+		f << "\n], \"displayTimeUnit\": \"ms\"}\n";
+		return !f.fail();
+	}
+
+
+
+	void StageProfiler::printSummary() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		std::cout << std::setw(24) << "stage" << std::setw(8) << "count" << std::setw(12) << "mean [ms]" << std::setw(12) << "p90 [ms]" << std::setw(12) << "max [ms]" << "\n";
+		for (std::map<std::string, StageStats>::const_iterator it = m_Stages.begin(); it != m_Stages.end(); ++it)
+		{
+			const StageStats& s = it->second;
+			std::cout << std::setw(24) << it->first << std::setw(8) << s.count << std::setw(12) << s.totalUs / s.count / 1000.0
+				<< std::setw(12) << s.percentile(0.9) / 1000.0 << std::setw(12) << s.maxUs / 1000.0 << "\n";
+		}
+	}
+
+
+
+	void StageProfiler::clear()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stages.clear();
+		m_Events.clear();
+	}
+
+
+
+	void StageProfiler::StageStats::add(double us)
+	{
+		minUs = count ? std::min(minUs, us) : us;
+		maxUs = count ? std::max(maxUs, us) : us;
+		++count;
+		totalUs += us;
+		++buckets[bucketOf(us)];
+	}
+
+
+
+	double StageProfiler::StageStats::percentile(double p) const
+	{
+		// upper bound of the bucket which contains the percentile, but never more than the max.
+		const int rank = static_cast<int>(std::ceil(p * count));
+		int sum = 0;
+		for (int b = 0; b < numBuckets; ++b)
+		{
+			sum += buckets[b];
+			if (sum >= rank && sum > 0)
+			{
+				return std::min(bucketUpperBound(b), maxUs);
+			}
+		}
+		return maxUs;
+	}
+
+
+
+	int StageProfiler::StageStats::bucketOf(double us)
+	{
+		if (us < 1.0)
+		{
+			return 0;
+		}
+		const int bucket = static_cast<int>(4.0 * std::log(us) / std::log(2.0));
+		return std::min(bucket, numBuckets - 1);
+	}
+
+
+
+	double StageProfiler::StageStats::bucketUpperBound(int bucket)
+	{
+		return std::pow(2.0, (bucket + 1) / 4.0);
+	}
+}
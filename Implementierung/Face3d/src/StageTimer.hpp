@@ -0,0 +1,125 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+/*
+Timing of the pipeline stages. A ScopedStageTimer measures the scope it lives in and reports to the StageProfiler,
+which collects a histogram per stage over all runs (e.g. a whole batch) and the single events for a Chrome trace (chrome://tracing).
+When the profiler is disabled (the default) a timer costs a single check of a flag.
+*/
+
+namespace Face3D
+{
+	/** singleton which collects the stage timings of all threads */
+	class StageProfiler
+	{
+	public:
+		static StageProfiler& Instance();
+
+		/** \brief  start or stop collecting, the collected data is kept */
+		void setEnabled(bool enabled) { m_Enabled = enabled; }
+		bool isEnabled() const { return m_Enabled; }
+
+		/** \brief  add a measurement
+		* \param stage name of the stage, must be a string literal (it is not copied)
+		* \param imgNr front or side image, -1 if the stage works on both
+		* \param startTicks cv::getTickCount() at the start
+		* \param endTicks cv::getTickCount() at the end
+		*/
+		void record(const char* stage, int imgNr, int64 startTicks, int64 endTicks);
+
+		/** \brief  summary of all stages: count, total, mean, min, max, percentiles and the histogram (JSON)
+		* \return false if the file couldn't be written
+		*/
+		bool writeSummary(const std::string& fn) const;
+
+		/** \brief  all events in the Chrome trace event format, to be loaded in chrome://tracing
+		* \return false if the file couldn't be written
+		*/
+		bool writeChromeTrace(const std::string& fn) const;
+
+		/** print count and mean of each stage */
+		void printSummary() const;
+
+		/** forget everything collected so far */
+		void clear();
+
+	private:
+		StageProfiler();
+		StageProfiler(const StageProfiler&);
+		StageProfiler& operator=(const StageProfiler&);
+
+		/** durations of a stage: logarithmic histogram, 4 buckets per power of 2 (1us .. ~1h) */
+		struct StageStats
+		{
+			static const int numBuckets = 4 * 32;
+
+			StageStats() : count(0), totalUs(0.0), minUs(0.0), maxUs(0.0), buckets(numBuckets, 0){}
+			void add(double us);
+			double percentile(double p) const;
+			static int bucketOf(double us);
+			static double bucketUpperBound(int bucket);
+
+			int count;
+			double totalUs, minUs, maxUs;
+			std::vector<int> buckets;
+		};
+
+		/** a single measurement, for the trace */
+		struct Event
+		{
+			const char* stage;
+			int imgNr;
+			int thread; ///< small number of the thread, in the order the threads were seen
+			double startUs, durationUs; ///< relative to the creation of the profiler
+		};
+
+		/** the trace is limited, the histograms are not */
+		static const size_t maxEvents = 1000000;
+
+		std::atomic<bool> m_Enabled;
+		int64 m_StartTicks;
+		mutable std::mutex m_Mutex;
+		std::map<std::string, StageStats> m_Stages;
+		std::vector<Event> m_Events;
+		std::map<std::thread::id, int> m_Threads;
+	};
+
+	/** measures the time until the end of the scope */
+	class ScopedStageTimer
+	{
+	public:
+		/** \brief  start the measurement
+		* \param stage name of the stage, must be a string literal
+		* \param imgNr front or side image, -1 if the stage works on both
+		*/
+		explicit ScopedStageTimer(const char* stage, int imgNr = -1)
+			: m_Stage(stage)
+			, m_ImgNr(imgNr)
+			, m_Start(StageProfiler::Instance().isEnabled() ? cv::getTickCount() : 0)
+		{
+		}
+
+		~ScopedStageTimer()
+		{
+			if (m_Start && StageProfiler::Instance().isEnabled())
+			{
+				StageProfiler::Instance().record(m_Stage, m_ImgNr, m_Start, cv::getTickCount());
+			}
+		}
+
+	private:
+		ScopedStageTimer(const ScopedStageTimer&);
+		ScopedStageTimer& operator=(const ScopedStageTimer&);
+
+		const char* m_Stage;
+		int m_ImgNr;
+		int64 m_Start;
+	};
+}
@@ -31,6 +31,41 @@ namespace Face3D
 			return it->second;
 		}
 
+		// Create an OpenGL texture
+		GLuint textureID;
+		glGenTextures(1, &textureID);
+		try
+		{
+			uploadFile(textureID, fileName);
+		}
+		catch (...)
+		{
+			glDeleteTextures(1, &textureID);
+			throw;
+		}
+
+		// Add textureID to cache
+		m_TextureCache[fileName] = textureID;
+
+		return textureID;
+	}
+
+	GLuint Texture::reloadFromImage(const std::string& fileName)
+	{
+		// not loaded yet: nothing to replace
+		auto it = m_TextureCache.find(fileName);
+		if (it == m_TextureCache.end())
+		{
+			return loadFromImage(fileName);
+		}
+
+		// the same id, so everything which uses the texture gets the new image
+		uploadFile(it->second, fileName);
+		return it->second;
+	}
+
+	void Texture::uploadFile(GLuint textureID, const std::string& fileName)
+	{
 		int textureWidth = 0;
 		int textureHeight = 0;
 		int components = 0;
@@ -41,28 +76,61 @@ namespace Face3D
 		{
 			throw std::exception("Could not load texture");
 		}
-			
 
-		// Create an OpenGL texture
-		GLuint textureID;
-		glGenTextures(1, &textureID);
+		upload(textureID, textureWidth, textureHeight, GL_RGB, image, 0);
+
+		// Free image / memory
+		stbi_image_free(image);
+	}
+
+	GLuint Texture::loadFromMemory(const std::string& name, const ImageView& image)
+	{
+		if (!image.data || image.width <= 0 || image.height <= 0 || image.step % 3 != 0)
+		{
+			throw std::exception("Could not load texture from memory");
+		}
+
+		// a new image for an existing texture replaces its content
+		GLuint textureID = 0;
+		auto it = m_TextureCache.find(name);
+		if (it != m_TextureCache.end())
+		{
+			textureID = it->second;
+		}
+		else
+		{
+			glGenTextures(1, &textureID);
+			m_TextureCache[name] = textureID;
+		}
+
+		// the rows of a cv::Mat are not aligned and may be longer than the image (a roi), OpenGL reads them as they are
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		upload(textureID, image.width, image.height, GL_BGR, image.data, static_cast<int>(image.step / 3));
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		return textureID;
+	}
+
+	void Texture::upload(GLuint textureID, int width, int height, GLenum format, const unsigned char* pixels, int rowLength)
+	{
 		// Bind it
 		glBindTexture(GL_TEXTURE_2D, textureID);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
 
 		// Hand the image to OpenGL
 		const int variant = 1; // better use 1 as it works on any PC I tried, while 2 sometimes yields strange effects (black textures)
 		switch (variant)
 		{
 		case 1:
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, textureWidth, textureHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
 			break;
 
 		case 2:
-			glTexStorage2D(GL_TEXTURE_2D, 4, GL_RGB8, textureWidth, textureHeight);
-			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, textureWidth, textureHeight, GL_RGB, GL_UNSIGNED_BYTE, image);
+			glTexStorage2D(GL_TEXTURE_2D, 4, GL_RGB8, width, height);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, pixels);
 			break;
 		}
-			
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
 		glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -72,14 +140,8 @@ namespace Face3D
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
 
-		// Free image / memory
-		stbi_image_free(image);
-		// Add textureID to cache
-		m_TextureCache[fileName] = textureID;
 		// unbind
 		glBindTexture(GL_TEXTURE_2D, 0);
-
-		return textureID;
 	}
 
 	void Texture::changeTextureSettings(TextureSetting setting)
@@ -5,6 +5,7 @@
 #include <map>
 #include <string>
 #include "GLHeader.hpp"
+#include "FaceData.hpp"
 
 namespace Face3D
 {
@@ -14,6 +15,16 @@ namespace Face3D
 		public:
 			static Texture& Instance();
 			GLuint Texture::loadFromImage(const std::string& fileName);
+
+			/** \brief  read the file again, e.g. after it was changed. the texture keeps its id. */
+			GLuint reloadFromImage(const std::string& fileName);
+
+			/** \brief  upload an image from memory, the BGR pixels are passed to OpenGL as they are (no decoding, no conversion)
+			* \param name name of the texture in the cache, an existing texture of this name gets the new image
+			* \param image 8 bit BGR image, e.g. a texture of the detection
+			*/
+			GLuint loadFromMemory(const std::string& name, const ImageView& image);
+
 			GLuint getSamplerID();
 
 			enum TextureSetting { TextureLinear, TextureNearest, TextureMIPNearest, TextureMIPLinear };
@@ -22,6 +33,15 @@ namespace Face3D
 
 		private:
 			Texture();
+
+			/** decode the file and upload it into the given texture */
+			void uploadFile(GLuint textureID, const std::string& fileName);
+
+			/** hand the pixels to OpenGL and set the parameters
+			* \param rowLength pixels from one row to the next, 0 if the rows are packed (with the default alignment of 4 bytes)
+			*/
+			void upload(GLuint textureID, int width, int height, GLenum format, const unsigned char* pixels, int rowLength);
+
 			std::map<std::string, GLuint> m_TextureCache;
 			GLuint samplerID = 0;
 			TextureSetting m_CurrSetting;
@@ -1,10 +1,96 @@
 #include "Viewer.hpp"
 #include <exception>
 #include "GLDebug.hpp"
+#include "ResultChannel.hpp"
 #include <iostream>
+#include <memory>
+#include <cstdint>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
 
 namespace Face3D
 {
+	namespace
+	{
+		/** time of the last change of a file, 0 if it doesn't exist */
+		uint64_t modificationTime(const std::string& fn)
+		{
+#ifdef _WIN32
+			WIN32_FILE_ATTRIBUTE_DATA data;
+			if (!GetFileAttributesExA(fn.c_str(), GetFileExInfoStandard, &data))
+			{
+				return 0;
+			}
+			return (static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+			struct stat st;
+			if (stat(fn.c_str(), &st) != 0)
+			{
+				return 0;
+			}
+			return static_cast<uint64_t>(st.st_mtime) * 1000000000ull + st.st_mtim.tv_nsec;
+#endif
+		}
+
+		/** the files of the detection, checked some times per second. the detection replaces each file as a whole, the textures first
+		* and the geometry last: a new geometry means that the textures of the same result are already there. */
+		class IpcWatcher
+		{
+		public:
+			explicit IpcWatcher(const Model::ModelInfo& modelInfo)
+				: m_ModelInfo(modelInfo)
+				, m_LastCheck(0.0)
+			{
+				m_Geometry = modificationTime(modelInfo.geometry);
+				m_Front = modificationTime(modelInfo.textureFront);
+				m_Side = modificationTime(modelInfo.textureSide);
+			}
+
+			void update(Model& model)
+			{
+				const double now = glfwGetTime();
+				if (now - m_LastCheck < 0.25)
+				{
+					return;
+				}
+				m_LastCheck = now;
+
+				// a file which can't be read (e.g. deleted) is tried again next time
+				const uint64_t geometry = modificationTime(m_ModelInfo.geometry);
+				if (geometry == m_Geometry)
+				{
+					return;
+				}
+				try
+				{
+					GeometryRecord record;
+					readGeometry(m_ModelInfo.geometry, record);
+
+					// only the textures which have changed are uploaded
+					const uint64_t front = modificationTime(m_ModelInfo.textureFront);
+					const uint64_t side = modificationTime(m_ModelInfo.textureSide);
+					model.reloadTextureFiles(front != m_Front, side != m_Side);
+					model.setGeometry(record);
+					m_Geometry = geometry;
+					m_Front = front;
+					m_Side = side;
+					std::cout << "result reloaded\n";
+				}
+				catch (std::exception e)
+				{
+				}
+			}
+
+		private:
+			const Model::ModelInfo& m_ModelInfo;
+			uint64_t m_Geometry, m_Front, m_Side;
+			double m_LastCheck;
+		};
+	}
+
 
 	void Viewer::initOpenGL()
 	{
@@ -107,21 +193,75 @@ namespace Face3D
 	}
 
 
-	void Viewer::run()
+	Model::ModelInfo Viewer::createModelInfo()
 	{
-
 		// load model, front and side texture
 		Model::ModelInfo modelInfo;
 		// file path
 		modelInfo.modelPath = "models/simpleSingleMesh2.obj";
+		modelInfo.geometry = "ipc/faceGeometry.bin";
 		modelInfo.textureFront = "ipc/front.jpg";
 		modelInfo.textureSide = "ipc/side.jpg";
 		
 		loadModelCoordinates(modelInfo);
+		return modelInfo;
+	}
+
 
+	void Viewer::run()
+	{
 		// load model
+		const Model::ModelInfo modelInfo = createModelInfo();
 		Model model(modelInfo);
-		
+
+		// the detection may run again while the model is shown
+		IpcWatcher watcher(modelInfo);
+		renderLoop(model, [&watcher](Model& m){ watcher.update(m); });
+	}
+
+
+	void Viewer::run(const ResultChannel& channel)
+	{
+		// the model is created directly from the shared memory. if the detection went around the whole ring
+		// in the meantime, the slot got overwritten during the upload: take the newest result again
+		std::unique_ptr<Model> model;
+		FaceData face;
+		ResultChannel::Token token;
+		do
+		{
+			while (!channel.latest(face, token))
+			{
+				std::cout << "waiting for the detection\n";
+				channel.wait(token.published, 1000);
+			}
+			model.reset(new Model(createModelInfo(), face));
+		} while (!channel.isUnchanged(token));
+
+		// newer results: only the deformation is done again and the textures are uploaded from the slot
+		renderLoop(*model, [&](Model& m)
+		{
+			if (channel.wait(token.published, 0) == token.published)
+			{
+				return;
+			}
+			ResultChannel::Token newToken;
+			if (channel.latest(face, newToken))
+			{
+				m.setGeometry(face.geometry);
+				m.setTextures(face);
+
+				// overwritten during the upload: the token stays, so the newest result is taken again with the next frame
+				if (channel.isUnchanged(newToken))
+				{
+					token = newToken;
+				}
+			}
+		});
+	}
+
+
+	void Viewer::renderLoop(Model& model, const std::function<void(Model&)>& update)
+	{
 		// transformation for model viewing
 		GLfloat rotationsVal = 0.0f;
 		GLfloat scaleVal = 0.002f;
@@ -141,6 +281,13 @@ namespace Face3D
 			GLfloat newTime = glfwGetTime();
 			GLfloat deltaTime =  newTime - oldTime;
 			oldTime = newTime;
+
+			// a new result of the detection
+			if (update)
+			{
+				update(model);
+			}
+
 			// clear window content
 			glBindFramebuffer(GL_FRAMEBUFFER, 0);
 			glClearColor(.5, .5, .5, 0);
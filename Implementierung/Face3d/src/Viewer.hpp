@@ -1,18 +1,27 @@
 #pragma once
 
+#include <functional>
 #include "GLHeader.hpp"
 #include "Model.hpp"
 
 
 namespace Face3D
 {
+	class ResultChannel;
+
 	/** the viewer class does all the OpenGL setup stuff and loads the face, the textures and finally shows them in 3d */
 	class Viewer
 	{
 	public:
 		void initOpenGL();
+
+		/** show the result of the detection program (ipc files), a new result written by the detection is shown while running */
 		void run();
 
+		/** show the newest result of a detection running as a separate process (FaceDetection --channel), waits for the first one.
+		* each new result is shown as soon as it is published. */
+		void run(const ResultChannel& channel);
+
 
 	private:
 		GLFWwindow* m_pWindow = 0;
@@ -20,6 +29,12 @@ namespace Face3D
 
 		// load coordinates of important vertices in generic model (this should be loaded from a file, e.g. CSV or XML)
 		void loadModelCoordinates(Model::ModelInfo& modelInfo);
+
+		// paths and coordinates of the generic model
+		Model::ModelInfo createModelInfo();
+
+		// show the model until the window gets closed, update is called before each frame to load new results
+		void renderLoop(Model& model, const std::function<void(Model&)>& update);
 	};
 
 }
\ No newline at end of file